@@ -0,0 +1,17 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aCenter;
+layout (location = 2) in vec2 aVelocity;
+
+uniform mat4 model;
+uniform vec3 slowColor;
+uniform vec3 fastColor;
+
+out vec3 particleColor;
+
+void main()
+{
+   // one instance per particle, the circle is scaled by model and moved to the particle
+   gl_Position = model * vec4(aPos, 0.0, 1.0) + vec4(aCenter, 0.0, 0.0);
+   particleColor = mix(slowColor, fastColor, min(length(aVelocity) / 2.0, 1.0));
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "Particle.h"
+#include "SignedDistanceField.h"
+#include "SpatialHash.h"
+
+// Adaptive particle refinement: particles near the free surface or static geometry are split
+// into four children of a quarter mass and half smoothing length, particles deep in the bulk
+// are merged pairwise back towards the base resolution. Simulation handles the mixed sizes
+// through Particle::sizeScale.
+class AdaptiveResolution
+{
+private:
+    float radius;
+    float minSizeScale;      // finest level
+    float splitDensityRatio; // density below this fraction of the mean marks the free surface
+    float mergeDensityRatio; // density above this fraction of the mean marks the bulk
+    const SignedDistanceField *boundaryField;
+    float obstacleBand;      // refine within this distance of static geometry
+    size_t maxParticles;
+    SpatialHash hash;
+    std::vector<glm::vec2> positions; // merge pass scratch, the hash bins these
+    std::vector<uint8_t> removed;
+
+    bool nearSurface(const Particle &particle, float meanDensity) const;
+
+    bool inBulk(const Particle &particle, float meanDensity) const;
+
+    void split(std::vector<Particle> &particles, float meanDensity);
+
+    void merge(std::vector<Particle> &particles, float meanDensity);
+
+public:
+    // levels: how many times a base particle may be split (each level halves the smoothing length)
+    AdaptiveResolution(float radius, int levels);
+
+    // Also refine within band of the geometry, the field must outlive this object
+    void setBoundaryField(const SignedDistanceField *field, float band);
+
+    // Never grow past this many particles, e.g. the capacity of a ParticlePool
+    void setMaxParticles(size_t count);
+
+    // Call between simulation steps (every few steps is enough); uses the densities of the last step
+    void refine(std::vector<Particle> &particles);
+};
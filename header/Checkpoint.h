@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <random>
+#include <cstdint>
+#include <cstddef>
+
+#include "Particle.h"
+#include "Simulation.h"
+
+// Versioned binary checkpoint: a fixed header, the raw particle array at a 64 byte aligned offset
+// and the RNG state. Files are little-endian and tied to the particle layout, so a float build
+// cannot load a double or SPH_COMPACT_PARTICLES checkpoint; that is reported instead of converted.
+struct CheckpointHeader
+{
+    static constexpr uint32_t currentVersion = 1;
+
+    char magic[8];          // "SPHCKPT"
+    uint32_t version;
+    uint32_t headerBytes;   // later versions append fields, older readers skip them
+    uint32_t byteOrder;     // 0x01020304 as written
+    uint32_t particleBytes; // sizeof the particle struct
+    uint32_t scalarBytes;   // 4 or 8
+    uint32_t compact;       // written by an SPH_COMPACT_PARTICLES build
+    uint64_t particleCount;
+    uint64_t particleOffset;
+    uint64_t rngOffset;     // std::mt19937 state in its standard text form
+    uint64_t rngBytes;
+    double time;
+    uint64_t step;
+    float radius;
+    float mass;
+    float damping;
+    float targetDensity;
+    float pressureMultiplier;
+    uint32_t periodic; // bit 0: x, bit 1: y
+};
+
+// Writes to filename.tmp and renames it over filename, so a crash never leaves half a checkpoint.
+// Throws std::runtime_error if the file cannot be written.
+template <typename Real>
+void writeCheckpoint(const char *filename, const std::vector<BasicParticle<Real>> &particles, const SimulationParameters &parameters,
+                     double time, uint64_t step, const std::mt19937 &rng);
+
+// Read-only memory mapping of a checkpoint. The particle array is used in place when the file offset
+// suits the particle alignment (always true for files written here); otherwise it is copied once.
+// Throws std::runtime_error on missing files, bad magic, newer versions or a different particle layout.
+class MappedCheckpoint
+{
+private:
+    const unsigned char *bytes;
+    size_t byteCount;
+    bool mapped;                          // false: bytes is an owned heap buffer (platforms without mmap)
+    CheckpointHeader header;
+    const void *particleData;
+    std::vector<std::max_align_t> copy; // only for misaligned particle arrays
+
+    template <typename Real>
+    void checkLayout() const;
+
+    void release();
+
+public:
+    explicit MappedCheckpoint(const char *filename);
+
+    ~MappedCheckpoint();
+
+    MappedCheckpoint(const MappedCheckpoint &) = delete;
+    MappedCheckpoint &operator=(const MappedCheckpoint &) = delete;
+
+    const CheckpointHeader &getHeader() const { return header; }
+
+    size_t size() const { return static_cast<size_t>(header.particleCount); }
+
+    double getTime() const { return header.time; }
+
+    uint64_t getStep() const { return header.step; }
+
+    SimulationParameters getParameters() const;
+
+    std::mt19937 getRng() const;
+
+    // Zero-copy view, valid while this object lives
+    template <typename Real>
+    const BasicParticle<Real> *particles() const
+    {
+        checkLayout<Real>();
+        return static_cast<const BasicParticle<Real> *>(particleData);
+    }
+
+    // One bulk copy into a solver's particle vector, which cannot adopt foreign memory
+    template <typename Real>
+    void restore(std::vector<BasicParticle<Real>> &out) const
+    {
+        const BasicParticle<Real> *first = particles<Real>();
+        out.assign(first, first + size());
+    }
+};
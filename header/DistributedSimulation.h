@@ -0,0 +1,89 @@
+#pragma once
+
+#include <mpi.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#include "Particle.h"
+#include "Simulation.h"
+
+// Runs one solver per MPI rank on a slab of the domain along x. Every step, particles that left
+// their slab migrate to the new owner. Then each rank appends ghost copies of the particles
+// within two interaction ranges of its slab and steps owned and ghost particles together.
+// The wide halo gives ghosts near the slab correct densities, so owned particles see the same
+// forces as in one big run without a second exchange inside the step. Slab cuts move to equal
+// particle counts when the load drifts apart. Long-range forces are not distributed.
+class DistributedSimulation
+{
+private:
+    MPI_Comm comm;
+    MPI_Datatype particleType; // sizeof(Particle) bytes, so counts and offsets are in particles
+    int rank;
+    int rankCount;
+    std::unique_ptr<SimulationBase> solver;
+    std::vector<float> cuts; // rankCount + 1 slab boundaries, the outer two are infinite
+    float rebalanceThreshold;
+    size_t ghostCount;
+    uint64_t rebalanceCount;
+
+    // reused exchange buffers
+    std::vector<std::pair<int, uint32_t>> outgoing; // (rank, particle)
+    std::vector<Particle> sendBuffer;
+    std::vector<int> sendCounts, sendOffsets, receiveCounts, receiveOffsets;
+    std::vector<uint32_t> histogram;
+
+    int ownerOf(float x) const;
+
+    // distance along x from x to the slab of rank r, through the periodic wrap if it is shorter
+    float slabDistance(float x, int r) const;
+
+    // Sends particles[outgoing[k].second] to outgoing[k].first and appends what arrives
+    void exchange(std::vector<Particle> &particles);
+
+    void migrate(std::vector<Particle> &particles);
+
+    void appendGhosts(std::vector<Particle> &particles, float width);
+
+    // Moves the cuts to equal particle counts if the busiest rank holds more than threshold times the mean
+    void rebalance(const std::vector<Particle> &particles);
+
+public:
+    // The solver must not be shared with other ranks. The slabs start evenly over the solver's domain.
+    DistributedSimulation(MPI_Comm comm, std::unique_ptr<SimulationBase> solver);
+
+    // Frees the particle datatype, so it must run before MPI_Finalize
+    ~DistributedSimulation();
+
+    DistributedSimulation(const DistributedSimulation &) = delete;
+    DistributedSimulation &operator=(const DistributedSimulation &) = delete;
+
+    // Keeps the particles of this rank's slab, e.g. after every rank generated the same initial set
+    void distribute(std::vector<Particle> &particles);
+
+    // particles holds this rank's particles before and after the step
+    void step(std::vector<Particle> &particles, float deltaTime, const std::vector<InteractionField> &fields);
+
+    // Imbalance (max / mean particle count) that triggers a rebalance; 0 rebalances every step
+    void setRebalanceThreshold(float threshold) { rebalanceThreshold = threshold; }
+
+    // Collects every rank's particles on root (other ranks get an empty vector)
+    void gather(const std::vector<Particle> &particles, std::vector<Particle> &all, int root) const;
+
+    int getRank() const { return rank; }
+
+    int getRankCount() const { return rankCount; }
+
+    SimulationBase &getSolver() { return *solver; }
+
+    float getSlabMin() const { return cuts[rank]; }
+
+    float getSlabMax() const { return cuts[rank + 1]; }
+
+    // Ghosts received in the last step
+    size_t getGhostCount() const { return ghostCount; }
+
+    uint64_t getRebalanceCount() const { return rebalanceCount; }
+};
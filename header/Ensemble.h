@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <cstddef>
+
+// One point of a parameter sweep, run headless with the default Simulation
+struct RunParameters
+{
+    int particles = 2000;
+    float pressureMultiplier = 10000.0f;
+    float targetDensity = 1.0f;
+    float damping = 1.0f;
+    float radius = 0.05f;
+    float mass = 1.0f;
+    int steps = 500;
+    float deltaTime = 0.003f;
+    unsigned seed = 1;
+};
+
+// Summary of the final state, plus cost
+struct RunMetrics
+{
+    double kineticEnergy = 0.0; // mean per particle, 0.5 * mass * |v|^2
+    double meanDensity = 0.0;
+    double densityError = 0.0;  // rms of (density - target) / target
+    double maxSpeed = 0.0;
+    double meanHeight = 0.0;    // mean y, shows how far the fluid has settled
+    double msPerStep = 0.0;
+    bool finite = true;         // false if the run blew up, the other values are then partial
+    bool failed = false;        // the run threw, e.g. out of memory; the other values are unset
+};
+
+// Reads a sweep file with one "name value [value ...]" line per parameter and '#' comments, e.g.
+//     particles 1000 4000
+//     pressureMultiplier 5000 10000 20000
+//     repeats 3
+// and returns the cartesian product. Unlisted parameters keep their defaults, repeats (default 1)
+// runs every combination with seeds 1..repeats. Throws std::runtime_error with the line on unknown names
+// and on values out of range, e.g. a negative particle count or a zero radius, step count or time step.
+std::vector<RunParameters> loadSweep(const char *filename);
+
+RunMetrics runSimulation(const RunParameters &parameters);
+
+// Runs every point on threads (0 = one per hardware thread), one single-threaded simulation per thread
+// at a time so the machine stays busy without oversubscription. Big runs start first.
+// done(runIndex, metrics) is called as runs finish, one call at a time; a run that throws is reported
+// with metrics.failed set.
+void runEnsemble(const std::vector<RunParameters> &runs, unsigned threads,
+                 const std::function<void(size_t, const RunMetrics &)> &done);
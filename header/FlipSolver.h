@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+#include "Particle.h"
+#include "SignedDistanceField.h"
+#include "MultigridSolver.h"
+#include "ThreadPool.h"
+
+// Hybrid particle-grid solver working on the same Particle storage as Simulation.
+// Particles carry velocity, a MAC grid does the pressure projection:
+//   particles -> grid (APIC), gravity, projection, grid -> particles (FLIP/APIC blend), advection.
+// The work per step is linear in particles plus grid cells, with no neighbor search.
+class FlipSolver
+{
+private:
+    glm::vec2 minCorner;
+    glm::vec2 maxCorner;
+    float cellSize;
+    int nx; // cells along x
+    int ny; // cells along y
+    float flipRatio;
+    bool apic;
+    glm::vec2 gravity;
+    const SignedDistanceField *boundaryField;
+    ThreadPool *pool;
+
+    std::vector<float> u, v;                 // face velocities, u is (nx + 1) * ny and v is nx * (ny + 1)
+    std::vector<float> uWeight, vWeight;     // transfer weights, reused as scratch
+    std::vector<float> uPrevious, vPrevious; // grid velocity before forces and projection, for the FLIP delta
+    std::vector<float> pressure;
+    std::vector<float> rhs;
+    std::vector<CellType> cellType;
+    MultigridSolver pressureSolver;
+    PoissonStats pressureStats;
+    std::vector<glm::vec2> affineX, affineY; // rows of the APIC affine velocity matrix per particle
+
+    // Particle indices sorted into bands of bandRows cell rows. A particle only splats into face rows
+    // next to its cell row, so bands two apart never touch the same face and P2G runs one colour at a time.
+    static constexpr int bandRows = 4;
+    int bandCount;
+    std::vector<uint32_t> bandOrder;   // particle indices, band by band, in index order within a band
+    std::vector<uint32_t> bandStart;   // bandCount + 1 offsets into bandOrder
+    std::vector<uint32_t> particleBand;
+    std::vector<uint32_t> blockCounts; // per block and band histogram, then scatter cursors
+
+    // runs body(chunkBegin, chunkEnd) over [0, count) on the pool, or inline without one
+    void forRange(size_t count, const std::function<void(size_t, size_t)> &body);
+
+    int cellRow(const glm::vec2 &position) const;
+
+    void binParticles(const std::vector<Particle> &particles);
+
+    void classifyCells(const std::vector<Particle> &particles);
+
+    void particlesToGrid(const std::vector<Particle> &particles);
+
+    void applyForces(float deltaTime);
+
+    void enforceSolidFaces();
+
+    void project(float deltaTime);
+
+    void gridToParticles(std::vector<Particle> &particles);
+
+    void advect(std::vector<Particle> &particles, float deltaTime);
+
+    bool isSolid(int i, int j) const;
+
+public:
+    // pool parallelizes the transfers, advection and pressure solve, it may be nullptr and must outlive the solver
+    FlipSolver(glm::vec2 minCorner, glm::vec2 maxCorner, float cellSize, ThreadPool *pool = nullptr);
+
+    // 0 = pure PIC/APIC (stable, dissipative), 1 = pure FLIP (lively, noisy)
+    void setFlipRatio(float ratio);
+
+    // APIC keeps an affine velocity per particle so the PIC part loses no angular momentum
+    void setAPIC(bool enabled);
+
+    // relative residual reduction and cycle cap for the multigrid pressure solve
+    void setPressureTolerance(float relative, int maxCycles);
+
+    // convergence and timing of the last pressure solve
+    const PoissonStats &getPressureStats() const { return pressureStats; }
+
+    // Solid cells from static geometry, the field must outlive the solver
+    void setBoundaryField(const SignedDistanceField *field);
+
+    void step(std::vector<Particle> &particles, float deltaTime);
+};
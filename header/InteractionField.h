@@ -0,0 +1,22 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// A user force acting on particles within radius of center, with a smooth falloff to zero at the edge
+struct InteractionField
+{
+    enum class Type
+    {
+        Attractor, // pulls towards center (negative strength pushes away)
+        Repulsor,  // pushes away from center
+        Vortex     // swirls counter-clockwise around center (negative strength for clockwise)
+    };
+
+    Type type;
+    glm::vec2 center;
+    float radius;
+    float strength;
+
+    InteractionField(Type t, const glm::vec2 &c, float r, float s)
+        : type(t), center(c), radius(r), strength(s) {}
+};
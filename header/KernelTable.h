@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+
+enum class KernelShape
+{
+    Poly6Spiky,  // Poly6 density kernel with the Spiky gradient (the analytic default)
+    CubicSpline, // M4 B-spline
+    WendlandC2
+};
+
+// A smoothing kernel sampled over q^2 = r^2 / h^2 and the magnitude of its gradient sampled over
+// q = r / h, both in [0, 1] and linearly interpolated. Every shape costs the same lookup, and
+// indexing values by q^2 means the density pass needs no square root. Gradients are indexed by q
+// because most of them have a square-root kink at the origin in q^2, and the pressure pass has
+// the distance anyway. Both tables are a few KB and stay in L1.
+class KernelTable
+{
+private:
+    static constexpr int samples = 512;
+
+    typedef std::array<float, samples + 1> Table;
+
+    KernelShape shape;
+    Table values;    // h^2 * W over q^2
+    Table gradients; // h^3 * dW/dr over q
+
+    static float interpolate(const Table &table, float x)
+    {
+        x *= samples;
+        int i = static_cast<int>(x);
+        if (i >= samples)
+            return 0.0f; // kernels vanish at the support radius
+        float t = x - i;
+        return table[i] + t * (table[i + 1] - table[i]);
+    }
+
+public:
+    explicit KernelTable(KernelShape shape = KernelShape::Poly6Spiky);
+
+    KernelShape getShape() const { return shape; }
+
+    // W(r, h) given r^2
+    float value(float distSq, float h) const
+    {
+        float inverseH2 = 1.0f / (h * h);
+        return interpolate(values, distSq * inverseH2) * inverseH2;
+    }
+
+    // dW/dr(r, h) given r
+    float gradient(float dst, float h) const
+    {
+        float inverseH = 1.0f / h;
+        return interpolate(gradients, dst * inverseH) * inverseH * inverseH * inverseH;
+    }
+
+    // Closed forms the table is generated from
+    static float analyticValue(KernelShape shape, float r, float h);
+    static float analyticGradient(KernelShape shape, float r, float h);
+
+    // Largest table error over a dense sweep of r in [0, h], relative to the peak analytic magnitude
+    void validate(float &valueError, float &gradientError, int sweep = 10000) const;
+};
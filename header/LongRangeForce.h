@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+#include "Particle.h"
+#include "ThreadPool.h"
+
+// All-pairs inverse-square interaction (self gravity or like charges) evaluated with a
+// Barnes-Hut quadtree: a cell whose size / distance is below the opening angle is treated
+// as a single body at its centre of mass, bringing the cost from O(N^2) to O(N log N).
+class LongRangeForce
+{
+public:
+    enum class Interaction
+    {
+        Gravity, // attractive
+        Coulomb  // repulsive, uniform charge to mass ratio
+    };
+
+private:
+    struct Node
+    {
+        glm::vec2 center;
+        float halfSize;
+        glm::vec2 centerOfMass;
+        float mass;
+        int firstChild; // index of four consecutive children, -1 for a leaf
+        uint32_t begin; // range into order for the particles below this node
+        uint32_t end;
+    };
+
+    Interaction interaction;
+    float strength;     // G or Coulomb constant times charge^2 / mass^2
+    float openingAngle; // theta, 0 reproduces the direct sum
+    float softening;    // keeps close encounters finite
+    ThreadPool *pool;
+    std::vector<Node> nodes;
+    std::vector<uint32_t> order; // particle indices, grouped by tree node
+    std::vector<glm::vec2> positions;
+    std::vector<float> masses;
+    std::vector<glm::vec2> accelerations;
+
+    void subdivide(int nodeIndex, int depth);
+
+    glm::vec2 evaluate(const glm::vec2 &pos, uint32_t self) const;
+
+public:
+    LongRangeForce(Interaction interaction, float strength, float openingAngle = 0.5f, float softening = 0.01f);
+
+    void setOpeningAngle(float theta);
+
+    // Evaluate particles in parallel, the pool must outlive this object
+    void setThreadPool(ThreadPool *threadPool);
+
+    // Rebuilds the tree and computes the acceleration of every particle from all the others.
+    // The tree works in float for either particle precision.
+    template <typename Real>
+    void compute(const std::vector<BasicParticle<Real>> &particles, float particleMass);
+
+    const std::vector<glm::vec2> &getAccelerations() const { return accelerations; }
+};
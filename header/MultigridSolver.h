@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "ThreadPool.h"
+
+enum class CellType : uint8_t
+{
+    Air,   // free surface, pressure fixed at zero
+    Fluid, // unknown
+    Solid  // wall, no flux
+};
+
+// Convergence and timing of one solve
+struct PoissonStats
+{
+    int cycles;
+    float initialResidual; // max norm over fluid cells
+    float finalResidual;
+    double milliseconds;
+};
+
+// Geometric multigrid for the pressure Poisson equation on a cell-centred grid with
+// irregular fluid/solid/air masks:  count_i * p_i - sum(p_j over non-solid neighbors j) = rhs_i
+// on fluid cells. V-cycles with red-black Gauss-Seidel smoothing, rows of each colour run in parallel.
+class MultigridSolver
+{
+private:
+    struct Level
+    {
+        int nx;
+        int ny;
+        std::vector<CellType> cellType;
+        std::vector<float> solution;
+        std::vector<float> rhs;
+        std::vector<float> residual;
+    };
+
+    std::vector<Level> levels;
+    ThreadPool *pool;
+    std::vector<float> rowNorms; // per-row partial max norms, reduced serially
+    float tolerance;
+    int maxCycles;
+    int preSmoothing;
+    int postSmoothing;
+    int coarseIterations;
+
+    void forRows(int rows, const std::function<void(int)> &body);
+
+    void smooth(Level &level, int iterations);
+
+    float computeResidual(Level &level);
+
+    void restrict(const Level &fine, Level &coarse);
+
+    void prolongate(const Level &coarse, Level &fine);
+
+    void vCycle(size_t depth);
+
+public:
+    // pool may be nullptr for a single-threaded solver; it must outlive the solver
+    MultigridSolver(int nx, int ny, ThreadPool *pool = nullptr);
+
+    // stop once the residual max norm has dropped by this factor
+    void setTolerance(float relative);
+
+    void setMaxCycles(int cycles);
+
+    void setSmoothing(int pre, int post);
+
+    // pressure is used as the initial guess and receives the solution
+    PoissonStats solve(const std::vector<CellType> &cellType, const std::vector<float> &rhs, std::vector<float> &pressure);
+};
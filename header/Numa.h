@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+// Minimal NUMA helpers read from sysfs, so no libnuma is needed. On other platforms, or when the
+// kernel reports no nodes, everything looks like one node and placement calls do nothing.
+namespace numa
+{
+    struct Topology
+    {
+        std::vector<int> cpus;     // CPUs this process may run on, grouped node by node
+        std::vector<int> cpuNode;  // dense node index of each entry in cpus
+        std::vector<int> nodeIds;  // kernel node id of each dense index
+    };
+
+    Topology topology();
+
+    // Restricts the calling thread to one CPU, returns false if the platform refused
+    bool pinCurrentThread(int cpu);
+
+    // CPUs the calling thread may run on, empty where affinity is not supported
+    std::vector<int> currentThreadCpus();
+
+    // Restores an affinity from currentThreadCpus(); does nothing for an empty list
+    bool setCurrentThreadCpus(const std::vector<int> &cpus);
+
+    // Migrates the pages overlapping [data, data + bytes) to a node (kernel id); best effort
+    bool movePages(const void *data, size_t bytes, int node);
+}
@@ -1,56 +1,64 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <cstdint>
 #include <vector>
-#include <cstdlib> // For rand()
+#include <random>
 #include <algorithm>
 
 #include <iostream> // debug
 
-struct Particle
+// Particle state in a chosen scalar precision, see Precision in SimulationPolicies.h.
+// Only persistent state lives here; per-step scratch (predicted positions, pressure forces)
+// is kept in transient buffers by the solvers.
+template <typename Real>
+struct BasicParticle
 {
+    typedef Real Scalar;
+    typedef glm::vec<2, Real> Vec;
 
-    glm::vec2 previousPosition;
-    glm::vec2 position;
-    glm::vec2 predictedPosition;
-    glm::vec2 velocity;
-    glm::vec2 gradient;
-    glm::vec2 pressureAcceleration;
-    float density;
+    Vec position;
+    Vec velocity;
+    Real density;
+    Real sizeScale; // smoothing length relative to the simulation radius, mass scales with its square
 
-    Particle(const glm::vec2 &pos, const glm::vec2 &vel)
-        : position(pos), velocity(vel), density(0.0f), previousPosition(pos) {}
-};
-
-std::vector<Particle> generateUniformGridParticles(int numParticles, float minX, float maxX, float minY, float maxY);
+#ifdef SPH_COMPACT_PARTICLES
+    // Compact storage: the last step's displacement as two fp16 values instead of a full position
+    uint32_t previousStep;
 
-std::vector<Particle> generateParticles(int numParticles, float minX, float maxX, float minY, float maxY);
+    Vec previous() const { return position - Vec(glm::unpackHalf2x16(previousStep)); }
 
-class Simulation
-{
-private:
-    float radius;
-    float mass;
-    float damping;
-    float targetDensity;
-    float pressureMultiplier;
-    float mouseForce;
-    glm::vec2 gravity;
-    float poly6KernelConstant;
-    float spikyKernelGradientConstant;
+    // Set after position, the displacement is taken relative to the current position
+    void setPrevious(const Vec &pos) { previousStep = glm::packHalf2x16(glm::vec2(position - pos)); }
+#else
+    Vec previousPosition;
 
-    void boundaryCondition(Particle &particles);
+    Vec previous() const { return previousPosition; }
 
-    void calculateDensity(std::vector<Particle> &particles);
+    void setPrevious(const Vec &pos) { previousPosition = pos; }
+#endif
 
-    void calculatePressureForce(std::vector<Particle> &particles);
+    BasicParticle(const Vec &pos, const Vec &vel)
+        : position(pos), velocity(vel), density(0), sizeScale(1)
+    {
+        setPrevious(pos);
+    }
 
-    float smoothingKernel(float dst);
+    // Converts between precisions, e.g. to start a double run from the float generators
+    template <typename Other>
+    explicit BasicParticle(const BasicParticle<Other> &other)
+        : position(other.position), velocity(other.velocity), density(Real(other.density)), sizeScale(Real(other.sizeScale))
+    {
+        setPrevious(Vec(other.previous()));
+    }
+};
 
-    float smoothingKernelDerivative(float dst);
+typedef BasicParticle<float> Particle;
+typedef BasicParticle<double> ParticleD;
 
-public:
-    Simulation(float rad, float mas, float damp, float targetDens, float pressureMult);
+std::vector<Particle> generateUniformGridParticles(int numParticles, float minX, float maxX, float minY, float maxY);
 
-    void updateParticles(std::vector<Particle> &particles, float deltaTime, glm::vec3 mouseVector);
-};
+// Uniformly random positions from a caller-owned generator, so runs are reproducible, independent
+// of each other and can save the generator state in a checkpoint
+std::vector<Particle> generateParticles(int numParticles, float minX, float maxX, float minY, float maxY, std::mt19937 &rng);
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <stdexcept>
+
+#include "Particle.h"
+
+// Inflow nozzle: a line segment centred on position, spraying along direction
+struct Emitter
+{
+    glm::vec2 position;
+    glm::vec2 direction; // unit vector
+    float width;         // nozzle width across direction
+    float speed;
+    float rate;          // particles per second
+    float accumulator;   // fractional particles carried over between steps
+
+    // Throws std::runtime_error for a zero or non-finite direction, which has no unit vector
+    Emitter(const glm::vec2 &pos, const glm::vec2 &dir, float w, float spd, float particlesPerSecond)
+        : position(pos), direction(dir), width(w), speed(spd), rate(particlesPerSecond), accumulator(0.0f)
+    {
+        const float length = glm::length(dir);
+        if (!(length > 0.0f) || !std::isfinite(length))
+            throw std::runtime_error("Emitter: the direction must be a finite nonzero vector");
+        direction /= length;
+    }
+};
+
+// Outflow region: particles entering the box are removed
+struct Sink
+{
+    glm::vec2 minCorner;
+    glm::vec2 maxCorner;
+
+    Sink(const glm::vec2 &minC, const glm::vec2 &maxC) : minCorner(minC), maxCorner(maxC) {}
+};
+
+// Fixed-capacity particle storage for inflow/outflow scenes. All memory is reserved up front:
+// slots freed by sinks go on a free list, emitters refill them first, and whatever is left
+// is compacted at the end of update() so the simulation always sees a dense array.
+class ParticlePool
+{
+private:
+    size_t capacity;
+    std::vector<Particle> particles;
+    std::vector<uint32_t> freeList;
+    std::vector<uint8_t> dead; // per slot, so a slot is freed at most once however often it is killed
+    std::vector<Emitter> emitters;
+    std::vector<Sink> sinks;
+    float nozzlePhase; // low-discrepancy position of the next particle across a nozzle
+
+    bool spawn(const glm::vec2 &pos, const glm::vec2 &vel, float deltaTime);
+
+public:
+    explicit ParticlePool(size_t capacity);
+
+    // Seeds the pool, e.g. with generateParticles; keeps at most capacity particles
+    void assign(const std::vector<Particle> &initial);
+
+    void addEmitter(const Emitter &emitter);
+    void addSink(const Sink &sink);
+
+    // Marks a slot as free, it stays in the array until refilled or compacted.
+    // Repeat kills of a slot and indices past size() are ignored.
+    void kill(uint32_t index);
+
+    // Moves live particles from the tail into free slots
+    void compact();
+
+    // Applies sinks, then emitters, then compacts. Call once per step before Simulation::updateParticles.
+    void update(float deltaTime);
+
+    std::vector<Particle> &getParticles() { return particles; }
+    size_t size() const { return particles.size(); }
+    size_t getCapacity() const { return capacity; }
+};
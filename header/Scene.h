@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "Simulation.h"
+#include "SignedDistanceField.h"
+#include "TrajectoryCodec.h"
+
+// A rectangle filled with fluid at startup
+struct FluidBlock
+{
+    glm::vec2 min = glm::vec2(-0.5f);
+    glm::vec2 max = glm::vec2(0.5f);
+    int particles = 500;
+    bool grid = false; // uniform grid instead of uniformly random positions
+    glm::vec2 velocity = glm::vec2(0.0f);
+};
+
+// Everything the viewer used to hard-code, loaded from a JSON scene file. The defaults are the old
+// hard-coded values, so an empty object {} gives the original scene.
+struct SceneSettings
+{
+    int windowWidth = 800;
+    int windowHeight = 800;
+
+    float mass = 1.0f;
+    float damping = 1.0f;
+    float timeStep = 0.003f;
+    float radius = 0.05f;
+    float targetDensity = 1.0f;
+    float pressureMultiplier = 10000.0f;
+    float mouseForce = 0.2f;
+
+    KernelType kernel = KernelType::Poly6Spiky;
+    IntegratorType integrator = IntegratorType::Verlet;
+    BoundaryType boundary = BoundaryType::Box;
+    bool mixedPrecision = false;
+    bool periodicX = true;
+    bool periodicY = true;
+    unsigned threads = 1; // including the main thread, 0 = one per hardware thread
+    bool numa = false;    // pin the threads (main thread included) and spread arrays over the NUMA nodes
+    unsigned seed = 1;
+    int sdfResolution = 256;
+
+    std::vector<FluidBlock> fluid = std::vector<FluidBlock>(1);
+    std::vector<Polyline> containers; // baked into a signed distance field with the obstacles
+    std::vector<Polyline> obstacles;
+
+    std::string checkpointFile = "checkpoint.sph";
+    std::string trajectoryFile = "trajectory.sphtraj";
+    uint32_t trajectoryInterval = 10;
+    bool compressTrajectory = true;
+    TrajectoryCodecSettings compression;
+    bool recordAtStart = false;
+    std::string vtkBasename = "sph";
+    uint32_t vtkInterval = 0; // steps between automatic exports, 0 = only on request
+};
+
+// Reads a scene file, e.g.
+//     {
+//         "window": {"width": 1024, "height": 1024},
+//         "physics": {"timeStep": 0.002, "pressureMultiplier": 20000},
+//         "solver": {"kernel": "wendlandC2", "integrator": "leapfrog", "threads": 0},
+//         "fluid": [{"min": [-0.9, -0.9], "max": [-0.1, 0.5], "particles": 2000, "layout": "grid"}],
+//         "obstacles": [{"type": "circle", "center": [0.4, -0.5], "radius": 0.2}],
+//         "output": {"trajectoryInterval": 5, "record": true}
+//     }
+// Every key is optional. Obstacles or containers switch the default box boundary to the SDF one.
+// Throws std::runtime_error with the file and line on syntax errors, unknown keys and bad values.
+SceneSettings loadScene(const char *filename);
+
+// Particles of every fluid block, positions drawn from rng
+std::vector<Particle> generateScene(const SceneSettings &scene, std::mt19937 &rng);
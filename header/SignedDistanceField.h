@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// A closed polygon, vertices in world space (the last vertex connects back to the first)
+typedef std::vector<glm::vec2> Polyline;
+
+// Static boundary geometry baked into a regular grid of signed distances.
+// Distances are positive inside the fluid region and negative inside solids.
+class SignedDistanceField
+{
+private:
+    glm::vec2 minCorner;
+    glm::vec2 maxCorner;
+    int width;  // grid nodes along x
+    int height; // grid nodes along y
+    glm::vec2 cellSize;
+    // distance, normal.x, normal.y interleaved per node so one lookup touches one cache line per row
+    std::vector<glm::vec3> nodes;
+
+    glm::vec2 nodePosition(int i, int j) const;
+
+    void computeNormals();
+
+public:
+    SignedDistanceField(glm::vec2 minCorner, glm::vec2 maxCorner, int resolution);
+
+    // Solid region = inside any obstacle, or outside every container (if any containers are given).
+    // Throws std::runtime_error if containers are given but no polygon has a vertex.
+    void bakePolylines(const std::vector<Polyline> &containers, const std::vector<Polyline> &obstacles);
+
+    // Pixels darker than the threshold are solid, the image is stretched over the field bounds.
+    // Throws std::runtime_error if no node borders one of the other kind, e.g. an all-solid image.
+    void bakeBitmap(const std::vector<uint8_t> &pixels, int bitmapWidth, int bitmapHeight, uint8_t threshold = 128);
+
+    // One bilinear lookup returning the signed distance and the outward (into fluid) unit normal.
+    // Non-finite positions read a border node instead of indexing out of range.
+    void sample(const glm::vec2 &pos, float &distance, glm::vec2 &normal) const;
+};
+
+// Text format: a line "container" or "obstacle" starts a new polygon, followed by one "x y" vertex per line.
+// Lines starting with '#' are comments.
+void loadPolylines(const char *filename, std::vector<Polyline> &containers, std::vector<Polyline> &obstacles);
+
+// Reads a binary (P5) or ASCII (P2) greyscale PGM image, rows stored bottom-up to match world y
+std::vector<uint8_t> loadPGM(const char *filename, int &width, int &height);
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include <type_traits>
+
+#include "Particle.h"
+#include "SignedDistanceField.h"
+#include "SpatialGrid.h"
+#include "SpatialHash.h"
+#include "InteractionField.h"
+#include "KernelTable.h"
+#include "SimulationPolicies.h"
+#include "StepArena.h"
+#include "TaskGraph.h"
+#include "ThreadPool.h"
+
+class LongRangeForce;
+
+// Runtime settings of a solver, e.g. to construct an equivalent one when restarting from a checkpoint
+struct SimulationParameters
+{
+    float radius;
+    float mass;
+    float damping;
+    float targetDensity;
+    float pressureMultiplier;
+    bool periodicX;
+    bool periodicY;
+};
+
+// Runtime interface and the state every policy combination shares, per particle storage precision
+template <typename Real>
+class BasicSimulationBase
+{
+public:
+    typedef BasicParticle<Real> ParticleType;
+
+protected:
+    typedef glm::vec<2, Real> Vec;
+
+    float radius;
+    float mass;
+    float damping;
+    float targetDensity;
+    float pressureMultiplier;
+    glm::vec2 gravity;
+    BoundarySettings boundary;
+    bool periodicAllowed; // only the periodic boundary honors setPeriodic
+    bool unbounded;       // neighbors and field queries go through the hash
+    LongRangeForce *longRangeForce; // optional, not owned
+    ThreadPool *pool;               // optional, not owned
+    const void *placedParticles;    // particle array last spread over a NUMA-aware pool's nodes
+    size_t placedCount;
+    TaskGraph graph;                // per-chunk phases, rebuilt when the chunk count changes
+    size_t graphItems;
+    StepArena arena;                 // per-step scratch, reset at the end of every update
+    Vec *predicted;                  // arena: positions the forces are evaluated at
+    Vec *pressureAcceleration;       // arena: consumed by the integration loop
+    glm::vec2 *externalAcceleration; // arena: from interaction fields, per particle
+    std::vector<uint32_t> fieldStamp;             // last field that touched each particle, dedups hash collisions
+    uint32_t stampCounter;
+    std::vector<InteractionField> mouseFields;    // reused so the mouse overload does not allocate
+    SpatialGrid grid;
+    SpatialHash hash; // used instead of grid when unbounded
+
+    BasicSimulationBase(float rad, float mas, float damp, float targetDens, float pressureMult, bool periodic, bool open);
+
+    // Per-particle loop that first touches step buffers. On a NUMA-aware pool it runs in fixed
+    // per-thread ranges, so the pages of index-ordered buffers spread over the nodes like the particles.
+    // The task phases visit particles by cell, not by index, so this balances memory bandwidth between
+    // the nodes; it does not keep a task's accesses on its own node.
+    template <typename Body>
+    void forEachStatic(size_t count, Body &&body)
+    {
+        if (pool && pool->isNumaAware())
+        {
+            pool->parallelForStatic(0, count, [&](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                    body(i);
+            });
+        }
+        else
+        {
+            for (size_t i = 0; i < count; ++i)
+                body(i);
+        }
+    }
+
+    // Spreads the pages of the particle and grid arrays evenly over a NUMA-aware pool's nodes, once per
+    // reallocation; particles generated on the main thread would otherwise all sit on one node. The grid
+    // arrays are in cell order, so their shares roughly follow the chunk runs the task graph seeds each
+    // worker with. The particle array is in index order, so a chunk still reads particles from every node.
+    void placeArrays(const std::vector<ParticleType> &particles);
+
+    // Only visits grid cells overlapping each field, so cost scales with the affected area
+    void applyInteractionFields(std::vector<ParticleType> &particles, const std::vector<InteractionField> &fields, float deltaTime);
+
+public:
+    virtual ~BasicSimulationBase() = default;
+
+    float getRadius() const { return radius; }
+
+    const BoundarySettings &getBoundary() const { return boundary; }
+
+    SimulationParameters getParameters() const
+    {
+        return SimulationParameters{radius, mass, damping, targetDensity, pressureMultiplier, boundary.periodicX, boundary.periodicY};
+    }
+
+    // Scratch memory use; heapAllocations stops changing once the particle count settles
+    const ArenaStats &getArenaStats() const { return arena.getStats(); }
+
+    // Collide particles against baked obstacle/container geometry. Used by the SDF and open boundaries.
+    // The field must outlive the simulation; pass nullptr to go back to the plain box.
+    void setBoundaryField(const SignedDistanceField *field);
+
+    // Per-axis wrapping for the periodic boundary, e.g. a small tile standing in for bulk flow.
+    // Both axes wrap by default; other boundaries ignore this.
+    void setPeriodic(bool x, bool y);
+
+    // Runs the density, pressure and integration phases as per-chunk tasks on the pool's threads.
+    // A NUMA-aware pool also gets the particle and grid arrays spread over its nodes.
+    // The pool must outlive the simulation; pass nullptr to run on the calling thread.
+    void setThreadPool(ThreadPool *threadPool);
+
+    // Tasks the step scheduler has moved between threads, a measure of load imbalance
+    uint64_t getTaskSteals() const { return graph.getSteals(); }
+
+    // Adds an all-pairs long-range interaction (e.g. self gravity) evaluated by a Barnes-Hut tree each step.
+    // The force object must outlive the simulation; pass nullptr to remove it.
+    void setLongRangeForce(LongRangeForce *force);
+
+    virtual void updateParticles(std::vector<ParticleType> &particles, float deltaTime, const std::vector<InteractionField> &fields) = 0;
+
+    // mouseVector = (x, y, force): an attractor of radius 1, negative force repels
+    void updateParticles(std::vector<ParticleType> &particles, float deltaTime, glm::vec3 mouseVector);
+};
+
+typedef BasicSimulationBase<float> SimulationBase;
+typedef BasicSimulationBase<double> SimulationBaseD;
+
+// SPH solver with the kernel, time integrator, boundary and precision chosen at compile time,
+// so the pair loops carry no runtime switches. See SimulationPolicies.h for the options.
+template <typename Kernel, typename Integrator, typename Boundary, typename Precision = SinglePrecision>
+class BasicSimulation : public BasicSimulationBase<typename Precision::Storage>
+{
+public:
+    typedef typename Precision::Storage Real;
+    typedef typename Precision::Accum Accum;
+    typedef BasicSimulationBase<Real> Base;
+    typedef typename Base::ParticleType ParticleType;
+
+private:
+    typedef glm::vec<2, Real> Vec;
+    typedef glm::vec<2, Accum> AccumVec;
+
+    using Base::radius;
+    using Base::mass;
+    using Base::damping;
+    using Base::targetDensity;
+    using Base::pressureMultiplier;
+    using Base::gravity;
+    using Base::boundary;
+    using Base::longRangeForce;
+    using Base::arena;
+    using Base::predicted;
+    using Base::pressureAcceleration;
+    using Base::externalAcceleration;
+    using Base::grid;
+    using Base::hash;
+    using Base::pool;
+    using Base::graph;
+    using Base::graphItems;
+
+    // grid chunks are cost-balanced cell ranges, the open domain uses fixed particle ranges instead
+    static constexpr size_t chunksPerWorker = 8;
+    static constexpr size_t chunkParticles = 1024;
+
+    // Particle in the accumulation scalar, cell-relative storage integrates and collides through it
+    struct WideParticle
+    {
+        typedef Accum Scalar;
+        typedef AccumVec Vec;
+
+        Vec position;
+        Vec velocity;
+        Vec previousPosition;
+
+        Vec previous() const { return previousPosition; }
+
+        void setPrevious(const Vec &pos) { previousPosition = pos; }
+    };
+
+    Kernel kernel;
+    ParticleType *stepParticles; // particles of the running step, read by the task bodies
+    size_t stepCount;
+    Accum stepDeltaTime;
+    int *chunkStart; // arena: first cell of each grid chunk, plus the cell count
+
+    // Cell-relative storage, empty for the other precisions. The cells are radius sized and independent of
+    // the neighbor grid, so the open boundary works the same way. A particle whose position in the array no
+    // longer matches its anchor was moved by someone else (pool, checkpoint, FLIP) and is anchored again.
+    Accum anchorSize;
+    std::vector<glm::ivec2> anchorCell; // origin of each particle's cell in units of anchorSize
+    std::vector<Vec> anchorLocal;       // position relative to the cell origin
+    std::vector<Vec> anchorPrevious;    // previous position relative to the same origin
+    glm::ivec2 *predictedCell;          // arena: cell of each predicted position, fixed for the step
+    Vec *predictedLocal;                // arena: predicted positions relative to those cells
+
+    AccumVec anchorOrigin(size_t i) const { return AccumVec(anchorCell[i]) * anchorSize; }
+
+    // Picks the cell containing position and stores both positions relative to its origin
+    void anchor(size_t i, const AccumVec &position, const AccumVec &previous);
+
+    // Adopts particles that are new or were moved since the last step
+    void anchorParticles(const std::vector<ParticleType> &particles);
+
+    // Predicted offset from particle j to particle i, exact up to the float rounding of the result
+    Vec relativeOffset(size_t i, uint32_t j) const
+    {
+        AccumVec d = AccumVec(predictedCell[i] - predictedCell[j]) * anchorSize + (AccumVec(predictedLocal[i]) - AccumVec(predictedLocal[j]));
+        if constexpr (Boundary::periodic)
+            d = grid.offset(d, AccumVec(0));
+        return Vec(d);
+    }
+
+    // Density of particle i from its neighbors' predicted positions
+    void calculateDensity(size_t i);
+
+    // Pressure acceleration of particle i, needs the densities of all its neighbors
+    void calculatePressureForce(size_t i);
+
+    void integrate(size_t i);
+
+    // density(C) -> pressure(C and the chunks around it) -> integrate(C), one task each per chunk
+    void buildGraph(size_t items);
+
+    // Splits the grid into chunks of about equal neighbor work and links the tasks that share cells
+    void partitionCells();
+
+    size_t graphItemCount(size_t particleCount) const;
+
+    // Calls visit(particleIndex) for every particle of one chunk
+    template <typename Visitor>
+    void forEachInItem(uint32_t item, Visitor &&visit) const
+    {
+        if constexpr (Boundary::unbounded)
+        {
+            size_t begin = item * chunkParticles;
+            size_t end = std::min(begin + chunkParticles, stepCount);
+            for (size_t i = begin; i < end; ++i)
+                visit(i);
+        }
+        else
+            grid.forEachInCellRange(chunkStart[item], chunkStart[item + 1], visit);
+    }
+
+    // neighbor query of particle i against whichever structure the boundary uses. The structures hold
+    // float positions, so double and cell-relative storage recompute each offset from their own positions.
+    template <typename Visitor>
+    void forEachNeighbor(size_t i, Visitor &&visit) const
+    {
+        const Vec &pos = predicted[i];
+        if constexpr (std::is_same<Real, float>::value && !Precision::cellRelative)
+        {
+            if constexpr (Boundary::unbounded)
+                hash.forEachNeighbor(pos, visit);
+            else
+                grid.template forEachNeighbor<Boundary::periodic>(pos, visit);
+        }
+        else
+        {
+            auto exact = [&](uint32_t j, const glm::vec2 &)
+            {
+                if constexpr (Precision::cellRelative)
+                    visit(j, relativeOffset(i, j));
+                else if constexpr (Boundary::periodic)
+                    visit(j, grid.offset(pos, predicted[j]));
+                else
+                    visit(j, pos - predicted[j]);
+            };
+            if constexpr (Boundary::unbounded)
+                hash.forEachNeighbor(glm::vec2(pos), exact);
+            else
+                grid.template forEachNeighbor<Boundary::periodic>(glm::vec2(pos), exact);
+        }
+    }
+
+public:
+    BasicSimulation(float rad, float mas, float damp, float targetDens, float pressureMult, const Kernel &kernel = Kernel());
+
+    using Base::updateParticles;
+
+    void updateParticles(std::vector<ParticleType> &particles, float deltaTime, const std::vector<InteractionField> &fields) override;
+};
+
+// The original solver: Poly6/Spiky kernels, position Verlet, reflective box
+typedef BasicSimulation<Poly6SpikyKernel, VerletIntegrator, BoxBoundary> Simulation;
+
+enum class KernelType
+{
+    Poly6Spiky,
+    CubicSpline,
+    WendlandC2,
+    Tabulated
+};
+
+enum class IntegratorType
+{
+    Verlet,
+    Leapfrog,
+    SymplecticEuler
+};
+
+enum class BoundaryType
+{
+    Box,
+    Periodic,
+    SDF,
+    Open
+};
+
+// Picks the compiled combination at runtime, e.g. from a config file.
+// tableShape is only used by the tabulated kernel.
+std::unique_ptr<SimulationBase> makeSimulation(KernelType kernel, IntegratorType integrator, BoundaryType boundary,
+                                               float rad, float mas, float damp, float targetDens, float pressureMult,
+                                               KernelShape tableShape = KernelShape::Poly6Spiky);
+
+// Same for another precision, e.g. makeSimulation<MixedPrecision>(...) or makeSimulation<DoublePrecision>(...)
+template <typename Precision>
+std::unique_ptr<BasicSimulationBase<typename Precision::Storage>> makeSimulation(KernelType kernel, IntegratorType integrator, BoundaryType boundary,
+                                                                                  float rad, float mas, float damp, float targetDens, float pressureMult,
+                                                                                  KernelShape tableShape = KernelShape::Poly6Spiky);
@@ -0,0 +1,360 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+
+#include "Particle.h"
+#include "KernelTable.h"
+#include "SignedDistanceField.h"
+
+// Compile-time policies for BasicSimulation. Every member is small and inline so each
+// kernel/integrator/boundary combination compiles into its own branch-free pair loops.
+
+// ---------------------------------------------------------------- kernels
+// value() takes the squared distance (no square root in the density pass), gradient() returns dW/dr.
+
+struct Poly6SpikyKernel
+{
+    template <typename Real>
+    Real value(Real dstSq, Real h) const
+    {
+        Real inverseH2 = Real(1) / (h * h);
+        Real diff = Real(1) - dstSq * inverseH2;
+        return Real(4.0 / M_PI) * inverseH2 * diff * diff * diff;
+    }
+
+    template <typename Real>
+    Real gradient(Real dst, Real h) const
+    {
+        Real inverseH = Real(1) / h;
+        Real diff = Real(1) - dst * inverseH;
+        return Real(-30.0 / M_PI) * inverseH * inverseH * inverseH * diff * diff;
+    }
+};
+
+struct CubicSplineKernel
+{
+    template <typename Real>
+    Real value(Real dstSq, Real h) const
+    {
+        Real inverseH = Real(1) / h;
+        Real q = std::sqrt(dstSq) * inverseH;
+        Real sigma = Real(40.0 / (7.0 * M_PI)) * inverseH * inverseH;
+        if (q <= Real(0.5))
+            return sigma * (Real(6) * (q * q * q - q * q) + Real(1));
+        Real diff = Real(1) - q;
+        return sigma * Real(2) * diff * diff * diff;
+    }
+
+    template <typename Real>
+    Real gradient(Real dst, Real h) const
+    {
+        Real inverseH = Real(1) / h;
+        Real q = dst * inverseH;
+        Real sigma = Real(40.0 / (7.0 * M_PI)) * inverseH * inverseH * inverseH;
+        if (q <= Real(0.5))
+            return sigma * Real(6) * (Real(3) * q * q - Real(2) * q);
+        Real diff = Real(1) - q;
+        return -sigma * Real(6) * diff * diff;
+    }
+};
+
+struct WendlandC2Kernel
+{
+    template <typename Real>
+    Real value(Real dstSq, Real h) const
+    {
+        Real inverseH = Real(1) / h;
+        Real q = std::sqrt(dstSq) * inverseH;
+        Real diff = Real(1) - q;
+        Real diff2 = diff * diff;
+        return Real(7.0 / M_PI) * inverseH * inverseH * diff2 * diff2 * (Real(1) + Real(4) * q);
+    }
+
+    template <typename Real>
+    Real gradient(Real dst, Real h) const
+    {
+        Real inverseH = Real(1) / h;
+        Real q = dst * inverseH;
+        Real diff = Real(1) - q;
+        return Real(-140.0 / M_PI) * inverseH * inverseH * inverseH * q * diff * diff * diff;
+    }
+};
+
+// Any shape through an interpolated lookup table, every shape costs the same.
+// The table is float, so higher precision only applies to the sums around it.
+struct TabulatedKernel
+{
+    KernelTable table;
+
+    explicit TabulatedKernel(KernelShape shape = KernelShape::Poly6Spiky) : table(shape) {}
+
+    template <typename Real>
+    Real value(Real dstSq, Real h) const { return Real(table.value(float(dstSq), float(h))); }
+
+    template <typename Real>
+    Real gradient(Real dst, Real h) const { return Real(table.gradient(float(dst), float(h))); }
+};
+
+// ---------------------------------------------------------------- integrators
+// predict() gives the position the forces are evaluated at, integrate() advances one step.
+// All of them damp and clamp the velocity the same way and keep the previous position as the last position.
+// integrate() runs in the accumulation scalar Real and rounds to the particle storage once at the end.
+
+constexpr float maxParticleVelocity = 5.0f;
+
+// The clamp is per axis, so a particle moves at most this fast. Query paddings and MPI halos scale with it.
+constexpr float maxParticleSpeed = maxParticleVelocity * 1.4142136f; // sqrt(2) rounded up
+
+template <typename Real>
+void limitVelocity(glm::vec<2, Real> &velocity, Real damping)
+{
+    velocity *= damping;
+    velocity = glm::clamp(velocity, glm::vec<2, Real>(-Real(maxParticleVelocity)), glm::vec<2, Real>(Real(maxParticleVelocity)));
+}
+
+// Position Verlet, velocity is the central difference of positions
+struct VerletIntegrator
+{
+    template <typename ParticleT>
+    static typename ParticleT::Vec predict(const ParticleT &particle, typename ParticleT::Scalar deltaTime)
+    {
+        return particle.position + particle.velocity * deltaTime;
+    }
+
+    template <typename Real, typename ParticleT>
+    static void integrate(ParticleT &particle, const glm::vec<2, Real> &acceleration, Real deltaTime, Real damping)
+    {
+        typedef glm::vec<2, Real> Vec;
+        const typename ParticleT::Vec stored = particle.position;
+        const Vec position(stored);
+        const Vec previous(particle.previous());
+        Vec newPosition = Real(2) * position - previous + acceleration * deltaTime * deltaTime;
+        Vec velocity = (newPosition - previous) / (Real(2) * deltaTime);
+        limitVelocity(velocity, damping);
+        particle.velocity = typename ParticleT::Vec(velocity);
+        particle.position = typename ParticleT::Vec(newPosition);
+        particle.setPrevious(stored);
+    }
+};
+
+// Drift-kick-drift leapfrog: forces are evaluated at the half step position
+struct LeapfrogIntegrator
+{
+    template <typename ParticleT>
+    static typename ParticleT::Vec predict(const ParticleT &particle, typename ParticleT::Scalar deltaTime)
+    {
+        return particle.position + particle.velocity * (typename ParticleT::Scalar(0.5) * deltaTime);
+    }
+
+    template <typename Real, typename ParticleT>
+    static void integrate(ParticleT &particle, const glm::vec<2, Real> &acceleration, Real deltaTime, Real damping)
+    {
+        typedef glm::vec<2, Real> Vec;
+        const typename ParticleT::Vec stored = particle.position;
+        Vec velocity(particle.velocity);
+        Vec halfStep = Vec(stored) + velocity * (Real(0.5) * deltaTime);
+        velocity += acceleration * deltaTime;
+        limitVelocity(velocity, damping);
+        particle.velocity = typename ParticleT::Vec(velocity);
+        particle.position = typename ParticleT::Vec(halfStep + velocity * (Real(0.5) * deltaTime));
+        particle.setPrevious(stored);
+    }
+};
+
+// Semi-implicit Euler: kick, then drift with the new velocity
+struct SymplecticEulerIntegrator
+{
+    template <typename ParticleT>
+    static typename ParticleT::Vec predict(const ParticleT &particle, typename ParticleT::Scalar deltaTime)
+    {
+        return particle.position + particle.velocity * deltaTime;
+    }
+
+    template <typename Real, typename ParticleT>
+    static void integrate(ParticleT &particle, const glm::vec<2, Real> &acceleration, Real deltaTime, Real damping)
+    {
+        typedef glm::vec<2, Real> Vec;
+        const typename ParticleT::Vec stored = particle.position;
+        Vec velocity = Vec(particle.velocity) + acceleration * deltaTime;
+        limitVelocity(velocity, damping);
+        particle.velocity = typename ParticleT::Vec(velocity);
+        particle.position = typename ParticleT::Vec(Vec(stored) + velocity * deltaTime);
+        particle.setPrevious(stored);
+    }
+};
+
+// ---------------------------------------------------------------- boundaries
+// Runtime settings shared by the boundary policies
+struct BoundarySettings
+{
+    glm::vec2 domainMin;
+    glm::vec2 domainMax;
+    bool periodicX;
+    bool periodicY;
+    const SignedDistanceField *field; // not owned
+};
+
+namespace boundary
+{
+    constexpr float damping = 0.5f;
+    constexpr float push = 0.02f;
+    constexpr float eps = 0.001f; // For position comparisons
+
+    // Reflect one axis off [minVal, maxVal], or wrap it when periodic. The previous position moves with
+    // the particle so Verlet sees no velocity spike; on a wall hit the velocity along the axis is dropped.
+    // Returns whether the previous position changed.
+    template <typename Real>
+    bool handleAxis(Real &pos, Real &prevPos, Real &vel, Real minVal, Real maxVal, bool periodic)
+    {
+        const Real span = maxVal - minVal;
+
+        if (periodic)
+        {
+            const Real shift = span * std::floor((pos - minVal) / span);
+            if (shift == Real(0))
+                return false;
+            pos -= shift;
+            prevPos -= shift;
+            return true;
+        }
+        // Check left boundary
+        else if (pos < minVal - Real(eps))
+        {
+            const Real overshoot = minVal - pos;
+            pos = minVal + overshoot * Real(damping);
+            prevPos = pos; // Reset previous position to prevent velocity spikes
+            vel = Real(0);
+            return true;
+        }
+        // Check right boundary
+        else if (pos > maxVal + Real(eps))
+        {
+            const Real overshoot = pos - maxVal;
+            pos = maxVal - overshoot * Real(damping);
+            prevPos = pos;
+            vel = Real(0);
+            return true;
+        }
+        // Gentle boundary push for particles near edges
+        else if (pos < minVal + Real(eps))
+        {
+            vel += Real(push);
+        }
+        else if (pos > maxVal - Real(eps))
+        {
+            vel -= Real(push);
+        }
+        return false;
+    }
+
+    template <typename ParticleT>
+    void handleBox(ParticleT &particle, const BoundarySettings &settings, bool periodicX, bool periodicY)
+    {
+        typedef typename ParticleT::Scalar Real;
+        typename ParticleT::Vec previous = particle.previous();
+        bool moved = handleAxis(particle.position.x, previous.x, particle.velocity.x, Real(settings.domainMin.x), Real(settings.domainMax.x), periodicX);
+        moved |= handleAxis(particle.position.y, previous.y, particle.velocity.y, Real(settings.domainMin.y), Real(settings.domainMax.y), periodicY);
+        if (moved)
+            particle.setPrevious(previous);
+    }
+
+    // Pushes a particle out of the static geometry along the field normal.
+    // The field is float, particles of any precision are sampled through it.
+    template <typename ParticleT>
+    void handleField(ParticleT &particle, const SignedDistanceField &field, bool nearPush)
+    {
+        typedef typename ParticleT::Scalar Real;
+        typedef typename ParticleT::Vec Vec;
+
+        float distance;
+        glm::vec2 sampledNormal;
+        field.sample(glm::vec2(particle.position), distance, sampledNormal);
+        const Vec normal(sampledNormal);
+        if (distance < -eps)
+        {
+            // same reflection as the box: mirror the overshoot back into the fluid, damped
+            particle.position -= normal * Real(distance * (1.0f + damping));
+            particle.setPrevious(particle.position);
+            particle.velocity -= normal * std::min(glm::dot(particle.velocity, normal), Real(0));
+        }
+        else if (nearPush && distance < eps)
+        {
+            particle.velocity += normal * Real(push);
+        }
+    }
+}
+
+// Reflective walls on the domain box
+struct BoxBoundary
+{
+    static constexpr bool periodic = false;
+    static constexpr bool unbounded = false;
+
+    template <typename ParticleT>
+    static void apply(ParticleT &particle, const BoundarySettings &settings)
+    {
+        boundary::handleBox(particle, settings, false, false);
+    }
+};
+
+// Wraps the axes flagged in the settings (both by default), the others stay reflective
+struct PeriodicBoundary
+{
+    static constexpr bool periodic = true;
+    static constexpr bool unbounded = false;
+
+    template <typename ParticleT>
+    static void apply(ParticleT &particle, const BoundarySettings &settings)
+    {
+        boundary::handleBox(particle, settings, settings.periodicX, settings.periodicY);
+    }
+};
+
+// Box walls plus static geometry from a signed distance field, one bilinear lookup per particle
+struct SdfBoundary
+{
+    static constexpr bool periodic = false;
+    static constexpr bool unbounded = false;
+
+    template <typename ParticleT>
+    static void apply(ParticleT &particle, const BoundarySettings &settings)
+    {
+        boundary::handleBox(particle, settings, false, false);
+        if (settings.field)
+            boundary::handleField(particle, *settings.field, true);
+    }
+};
+
+// No walls, neighbors come from a spatial hash so the fluid can travel anywhere.
+// Static geometry from the settings still applies.
+struct OpenBoundary
+{
+    static constexpr bool periodic = false;
+    static constexpr bool unbounded = true;
+
+    template <typename ParticleT>
+    static void apply(ParticleT &particle, const BoundarySettings &settings)
+    {
+        if (settings.field)
+            boundary::handleField(particle, *settings.field, false);
+    }
+};
+
+// ---------------------------------------------------------------- precision
+// Storage is the particle scalar; Accum is what density and force sums and the integration step run in.
+// With CellRelative the solver keeps every position as an integer cell plus a float offset from the cell
+// origin, so the stored resolution does not drop far from the world origin. The particle array then only
+// receives rounded absolute copies for rendering and the other modules.
+template <typename StorageT, typename AccumT, bool CellRelative = false>
+struct Precision
+{
+    typedef StorageT Storage;
+    typedef AccumT Accum;
+    static constexpr bool cellRelative = CellRelative;
+};
+
+typedef Precision<float, float> SinglePrecision;       // fastest, the original behavior
+typedef Precision<double, double> DoublePrecision;     // long runs, twice the particle memory
+typedef Precision<float, double, true> MixedPrecision; // float offsets from cell origins, double sums and integration
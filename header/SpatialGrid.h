@@ -0,0 +1,148 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+class ThreadPool;
+
+// Uniform cell grid over a fixed box, rebuilt every step with a counting sort.
+// Periodic axes wrap cell lookups and return minimum-image offsets, so no ghost copies are needed.
+class SpatialGrid
+{
+private:
+    glm::vec2 minCorner;
+    glm::vec2 extent;
+    glm::vec2 cellSize; // at least the requested size, stretched so cells tile the box exactly
+    int cellsX;
+    int cellsY;
+    bool periodicX;
+    bool periodicY;
+
+    std::vector<uint32_t> cellStart;       // cellsX * cellsY + 1 offsets into sortedIndices
+    std::vector<uint32_t> particleCell;    // cell of each particle
+    std::vector<uint32_t> sortedIndices;   // particle indices grouped by cell
+    std::vector<glm::vec2> sortedPositions; // positions in the same order, for cache friendly scans
+
+    int wrapCell(int c, int cells, bool periodic) const;
+
+    // up to three distinct cells along one axis around c
+    int neighborCells(int c, int cells, bool periodic, int out[3]) const;
+
+public:
+    static constexpr double maxCells = 1 << 26;
+
+    // Throws std::runtime_error if minCellSize would need more than maxCells cells
+    SpatialGrid(glm::vec2 minCorner, glm::vec2 maxCorner, float minCellSize);
+
+    void setPeriodic(bool x, bool y);
+
+    // Bins particle positions (usually the predicted ones), cells are found in float for either precision
+    template <typename Real>
+    void build(const glm::vec<2, Real> *positions, size_t count);
+
+    int getCellsX() const { return cellsX; }
+
+    int getCellsY() const { return cellsY; }
+
+    // a - b, wrapped to the nearest periodic image
+    template <typename T>
+    glm::vec<2, T> offset(const glm::vec<2, T> &a, const glm::vec<2, T> &b) const
+    {
+        glm::vec<2, T> d = a - b;
+        if (periodicX)
+            d.x -= T(extent.x) * std::round(d.x / T(extent.x));
+        if (periodicY)
+            d.y -= T(extent.y) * std::round(d.y / T(extent.y));
+        return d;
+    }
+
+    // Spreads the arrays over a NUMA-aware pool's nodes the way its static loops split them
+    void placePages(const ThreadPool &pool) const;
+
+    // Calls visit(particleIndex, offset) for every particle in the 3x3 cells around pos,
+    // with offset = pos - particlePosition. Callers still filter by distance.
+    // Wrap = false compiles out the periodic handling; only use it when no axis is periodic.
+    template <bool Wrap = true, typename Visitor>
+    void forEachNeighbor(const glm::vec2 &pos, Visitor &&visit) const
+    {
+        int cx = static_cast<int>(std::floor((pos.x - minCorner.x) / cellSize.x));
+        int cy = static_cast<int>(std::floor((pos.y - minCorner.y) / cellSize.y));
+        int xs[3], ys[3];
+        int countX = neighborCells(cx, cellsX, Wrap && periodicX, xs);
+        int countY = neighborCells(cy, cellsY, Wrap && periodicY, ys);
+
+        for (int b = 0; b < countY; ++b)
+        {
+            for (int a = 0; a < countX; ++a)
+            {
+                int cell = ys[b] * cellsX + xs[a];
+                for (uint32_t k = cellStart[cell]; k < cellStart[cell + 1]; ++k)
+                {
+                    if constexpr (Wrap)
+                        visit(sortedIndices[k], offset(pos, sortedPositions[k]));
+                    else
+                        visit(sortedIndices[k], pos - sortedPositions[k]);
+                }
+            }
+        }
+    }
+
+    int getCellCount() const { return cellsX * cellsY; }
+
+    // Estimated pair work of every cell (its particles times the particles in its 3x3 neighborhood)
+    // as a running sum: prefix[c + 1] - prefix[c] is the cost of cell c. prefix needs getCellCount() + 1 entries.
+    void cellCosts(uint64_t *prefix) const;
+
+    // Calls visit(particleIndex) for every particle binned into row-major cells [begin, end), in cell order
+    template <typename Visitor>
+    void forEachInCellRange(int begin, int end, Visitor &&visit) const
+    {
+        for (uint32_t k = cellStart[begin]; k < cellStart[end]; ++k)
+            visit(sortedIndices[k]);
+    }
+
+    // Calls visit(particleIndex) for every particle in the cells overlapping the circle, each cell once
+    template <typename Visitor>
+    void forEachInRadius(const glm::vec2 &center, float radius, Visitor &&visit) const
+    {
+        int x0 = static_cast<int>(std::floor((center.x - radius - minCorner.x) / cellSize.x));
+        int x1 = static_cast<int>(std::floor((center.x + radius - minCorner.x) / cellSize.x));
+        int y0 = static_cast<int>(std::floor((center.y - radius - minCorner.y) / cellSize.y));
+        int y1 = static_cast<int>(std::floor((center.y + radius - minCorner.y) / cellSize.y));
+        // a range wider than the grid covers every cell once
+        if (x1 - x0 >= cellsX)
+        {
+            x0 = 0;
+            x1 = cellsX - 1;
+        }
+        if (y1 - y0 >= cellsY)
+        {
+            y0 = 0;
+            y1 = cellsY - 1;
+        }
+        if (!periodicX)
+        {
+            x0 = wrapCell(x0, cellsX, false);
+            x1 = wrapCell(x1, cellsX, false);
+        }
+        if (!periodicY)
+        {
+            y0 = wrapCell(y0, cellsY, false);
+            y1 = wrapCell(y1, cellsY, false);
+        }
+
+        for (int y = y0; y <= y1; ++y)
+        {
+            int row = wrapCell(y, cellsY, periodicY) * cellsX;
+            for (int x = x0; x <= x1; ++x)
+            {
+                int cell = row + wrapCell(x, cellsX, periodicX);
+                for (uint32_t k = cellStart[cell]; k < cellStart[cell + 1]; ++k)
+                    visit(sortedIndices[k]);
+            }
+        }
+    }
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+class ThreadPool;
+
+// Spatial hash for unbounded domains: integer cell coordinates are hashed into a fixed table
+// and particles are sorted into contiguous per-bucket ranges. The table is sized from the particle
+// count, so memory follows the number of occupied cells rather than how far the fluid spreads.
+class SpatialHash
+{
+private:
+    float cellSize;
+    uint32_t tableMask; // table size is a power of two
+
+    std::vector<uint32_t> bucketStart;      // tableSize + 1 offsets into sortedIndices
+    std::vector<uint32_t> particleBucket;   // bucket of each particle
+    std::vector<uint32_t> sortedIndices;    // particle indices grouped by bucket
+    std::vector<glm::vec2> sortedPositions; // positions in the same order
+
+    int64_t cellCoordinate(float x) const
+    {
+        return static_cast<int64_t>(std::floor(x / cellSize));
+    }
+
+    uint32_t bucketOf(int64_t cx, int64_t cy) const
+    {
+        return ((static_cast<uint32_t>(cx) * 73856093u) ^ (static_cast<uint32_t>(cy) * 19349663u)) & tableMask;
+    }
+
+public:
+    explicit SpatialHash(float cellSize);
+
+    // Bins particle positions (usually the predicted ones), growing the table only when the particle count
+    // outgrows it. Cells are found in float for either precision.
+    template <typename Real>
+    void build(const glm::vec<2, Real> *positions, size_t count);
+
+    // Spreads the arrays over a NUMA-aware pool's nodes the way its static loops split them
+    void placePages(const ThreadPool &pool) const;
+
+    // Calls visit(particleIndex, offset) for every particle hashed into the 3x3 cells around pos,
+    // with offset = pos - particlePosition. Hash collisions bring in far particles, so callers filter by distance.
+    template <typename Visitor>
+    void forEachNeighbor(const glm::vec2 &pos, Visitor &&visit) const
+    {
+        int64_t cx = cellCoordinate(pos.x);
+        int64_t cy = cellCoordinate(pos.y);
+
+        // two neighboring cells may collide into one bucket, visit each bucket once
+        uint32_t visited[9];
+        int visitedCount = 0;
+        for (int64_t y = cy - 1; y <= cy + 1; ++y)
+        {
+            for (int64_t x = cx - 1; x <= cx + 1; ++x)
+            {
+                uint32_t bucket = bucketOf(x, y);
+                bool seen = false;
+                for (int v = 0; v < visitedCount; ++v)
+                    seen |= visited[v] == bucket;
+                if (seen)
+                    continue;
+                visited[visitedCount++] = bucket;
+
+                for (uint32_t k = bucketStart[bucket]; k < bucketStart[bucket + 1]; ++k)
+                    visit(sortedIndices[k], pos - sortedPositions[k]);
+            }
+        }
+    }
+
+    // Calls visit(particleIndex) for every particle hashed into the cells overlapping the circle.
+    // Colliding cells can report a particle more than once, and far particles too, so callers filter.
+    template <typename Visitor>
+    void forEachInRadius(const glm::vec2 &center, float radius, Visitor &&visit) const
+    {
+        int64_t x0 = cellCoordinate(center.x - radius), x1 = cellCoordinate(center.x + radius);
+        int64_t y0 = cellCoordinate(center.y - radius), y1 = cellCoordinate(center.y + radius);
+
+        // once the circle spans more cells than buckets, scanning the table is cheaper
+        if ((x1 - x0 + 1) * (y1 - y0 + 1) > static_cast<int64_t>(tableMask) + 1)
+        {
+            for (uint32_t k = 0; k < sortedIndices.size(); ++k)
+                visit(sortedIndices[k]);
+            return;
+        }
+
+        for (int64_t y = y0; y <= y1; ++y)
+        {
+            for (int64_t x = x0; x <= x1; ++x)
+            {
+                uint32_t bucket = bucketOf(x, y);
+                for (uint32_t k = bucketStart[bucket]; k < bucketStart[bucket + 1]; ++k)
+                    visit(sortedIndices[k]);
+            }
+        }
+    }
+};
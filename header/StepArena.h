@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <algorithm>
+
+struct ArenaStats
+{
+    size_t capacity;        // bytes reserved
+    size_t used;            // bytes handed out since the last reset
+    size_t highWater;       // most bytes used in any step
+    size_t heapAllocations; // blocks the arena has requested from the heap, stays constant in steady state
+};
+
+// Bump allocator for per-step scratch arrays. Memory is handed out aligned, never freed individually,
+// and released all at once by reset(). A step that overflows the current block chains a new one;
+// the next reset() folds everything into a single block, so a repeating step stops allocating.
+class StepArena
+{
+private:
+    struct Block
+    {
+        std::unique_ptr<unsigned char[]> memory;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t current; // block being bumped
+    size_t offset;  // into the current block
+    ArenaStats stats;
+
+    void *allocateBytes(size_t bytes, size_t alignment);
+
+    void addBlock(size_t minimumBytes);
+
+public:
+    explicit StepArena(size_t initialBytes = 1 << 20);
+
+    // Uninitialized storage for count objects, valid until the next reset()
+    template <typename T>
+    T *allocate(size_t count, size_t alignment = 64)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "arena memory is released without running destructors");
+        return static_cast<T *>(allocateBytes(count * sizeof(T), std::max(alignment, alignof(T))));
+    }
+
+    // Invalidates everything handed out so far
+    void reset();
+
+    const ArenaStats &getStats() const { return stats; }
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#include "ThreadPool.h"
+#include "WorkStealingDeque.h"
+
+// Dependency graph of small tasks that is built once and run every step.
+// Each task calls its phase body with an item index (e.g. a range of grid cells) and starts
+// as soon as every task it depends on has finished, so there are no full barriers between phases.
+// Workers run their own lock-free deque newest first and steal the oldest tasks from the others,
+// trying workers on their own NUMA node before crossing sockets.
+class TaskGraph
+{
+private:
+    struct Task
+    {
+        uint32_t phase;
+        uint32_t item;
+        uint32_t dependencies;
+    };
+
+    std::vector<std::function<void(uint32_t)>> phases;
+    std::vector<Task> tasks;
+    std::vector<uint64_t> edges; // (before << 32) | after, folded into successor lists on the next run
+    std::vector<uint32_t> successorStart;
+    std::vector<uint32_t> successors;
+    std::unique_ptr<std::atomic<uint32_t>[]> pending;
+    size_t pendingCapacity;
+    std::unique_ptr<WorkStealingDeque[]> queues; // one per worker
+    unsigned queueCount;
+    const ThreadPool *queuePool; // pool the victim order was computed for
+    std::vector<unsigned> victims; // per worker, queueCount - 1 others with same-node workers first
+    bool dirty;
+    std::atomic<size_t> remaining;
+    std::atomic<uint64_t> steals;
+
+    void finalize();
+
+    bool steal(unsigned worker, uint32_t &task);
+
+    void execute(unsigned worker, uint32_t task);
+
+    void workerLoop(unsigned worker);
+
+public:
+    TaskGraph();
+
+    // Removes all phases and tasks
+    void clear();
+
+    // Registers a body shared by all tasks of one phase, returns the phase id
+    uint32_t addPhase(std::function<void(uint32_t item)> body);
+
+    // Returns the task id
+    uint32_t addTask(uint32_t phase, uint32_t item);
+
+    // after only starts once before has finished
+    void addDependency(uint32_t before, uint32_t after);
+
+    // Drops every dependency but keeps phases and tasks, for graphs that are relinked each run
+    void clearDependencies();
+
+    // Room for count dependencies, so relinking up to that many each run never allocates
+    void reserveDependencies(size_t count);
+
+    size_t size() const { return tasks.size(); }
+
+    // Runs every task once, on the pool's threads if given, otherwise inline
+    void run(ThreadPool *pool);
+
+    // Tasks taken from another worker's queue since construction
+    uint64_t getSteals() const { return steals.load(std::memory_order_relaxed); }
+};
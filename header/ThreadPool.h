@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Persistent worker threads for data-parallel loops. The calling thread joins in as thread 0,
+// so a pool of size 1 simply runs the loop inline.
+// A NUMA-aware pool (opt-in) pins its threads to CPUs filled socket by socket, so neighboring thread
+// indices share a node and static loop ranges stay on one socket. That includes the constructing thread,
+// whose previous affinity comes back when the pool is destroyed. Pools alive at the same time take
+// CPUs after each other instead of stacking on the first ones.
+class ThreadPool
+{
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+
+    bool numaAware;
+    std::vector<int> threadCpu;  // pinned CPU per thread index, empty when not NUMA-aware
+    std::vector<int> callerCpus; // affinity of the constructing thread before it was pinned
+    std::vector<int> threadNode; // dense node index per thread index
+    std::vector<int> nodeIds;    // kernel id per dense node index
+
+    // current job, published under mutex and identified by generation
+    const std::function<void(size_t, size_t)> *job;
+    size_t jobBegin;
+    size_t jobEnd;
+    size_t grain;
+    bool staticSchedule;
+    std::atomic<size_t> next;
+    size_t busyWorkers;
+    uint64_t generation;
+    bool stopping;
+
+    void workerLoop(unsigned index);
+
+    void runChunks(unsigned index);
+
+    void dispatch(size_t begin, size_t end, const std::function<void(size_t, size_t)> &body, bool isStatic);
+
+public:
+    // threadCount includes the calling thread, 0 means one per hardware thread.
+    // numaAware = true pins the threads, the calling one included, and enables page placement.
+    explicit ThreadPool(unsigned threadCount = 0, bool numaAware = false);
+
+    // Joins the workers and gives the constructing thread its old affinity back, so it must run on
+    // that thread
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    bool isNumaAware() const { return numaAware; }
+
+    unsigned getNodeCount() const { return static_cast<unsigned>(nodeIds.size()); }
+
+    // Dense node index the thread runs on, 0 unless NUMA-aware
+    int getThreadNode(unsigned thread) const { return threadNode[thread]; }
+
+    // Calls body(chunkBegin, chunkEnd) over [begin, end) in dynamically scheduled chunks and waits for all of them
+    void parallelFor(size_t begin, size_t end, const std::function<void(size_t, size_t)> &body);
+
+    // Splits [begin, end) into size() equal ranges, thread t always gets the t-th. Loops that first touch
+    // a buffer this way leave each page on the node of the thread that later works on it.
+    void parallelForStatic(size_t begin, size_t end, const std::function<void(size_t, size_t)> &body);
+
+    // For buffers already touched by one thread (e.g. generated on the main thread): moves the pages of each
+    // thread's parallelForStatic share of [data, data + bytes) to that thread's node. No-op on a single node.
+    void placePages(const void *data, size_t bytes) const;
+};
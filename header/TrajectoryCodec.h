@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Lossy codec for trajectory frames in the TrajectoryWriter layout (position pairs, velocity pairs,
+// densities). Values are quantized to the field's error bound times its range in the last keyframe.
+// Keyframes sort particles by grid cell and code each value against the previous particle. Later
+// frames keep that order and code each value against a linear extrapolation of the particle's last two
+// frames. Residuals are Huffman coded by bit length and the remaining bits are stored raw.
+// Decoded frames list particles in the keyframe's cell order, which only changes at the next keyframe.
+struct TrajectoryCodecSettings
+{
+    // keyframes span 1 / (2 * errorBound) steps, which has to stay below the 2^24 step limit; finer
+    // bounds than 1e-6 would also be below the resolution of the floats themselves
+    static constexpr float minimumErrorBound = 1e-6f;
+    static constexpr float maximumErrorBound = 0.5f;
+
+    float errorBound = 1e-4f;       // maximum position error relative to the positions' range, e.g. the domain
+    // SPH velocities and densities change by far more than a fine step between recorded frames, so their
+    // residuals hardly shrink with prediction; a percent of the range still colours and plots smoothly
+    float velocityErrorBound = 1e-2f;
+    float densityErrorBound = 1e-2f;
+    uint32_t keyframeInterval = 30; // frames per keyframe, bounds how far a seek has to decode
+};
+
+// One quantized float stream of a frame, e.g. the x coordinates of the positions
+struct TrajectoryChannel
+{
+    size_t base;      // floats per particle of the fields stored before this one
+    size_t component;
+    size_t stride;    // 2 for vector fields, 1 for densities
+    uint32_t field;   // components of a field share one quantization step
+    float minimum;
+    float step;
+    std::vector<int32_t> current;
+    std::vector<int32_t> previous;
+    std::vector<int32_t> beforePrevious;
+};
+
+class TrajectoryEncoder
+{
+private:
+    TrajectoryCodecSettings settings;
+    std::vector<TrajectoryChannel> channels;
+    std::vector<uint32_t> order; // stream position -> particle index, fixed from keyframe to keyframe
+    std::vector<uint32_t> cellStart;
+    std::vector<uint32_t> symbols;
+    size_t particleCount;
+    uint32_t framesSinceKeyframe;
+    bool forceKeyframe;
+
+    void sortByCell(const float *frame, size_t count);
+
+    // Sets the quantization steps from the frame's ranges
+    void setRanges(const float *frame, size_t count);
+
+    // False if a value falls too far outside the keyframe's range, which then needs a new keyframe
+    bool quantize(const float *frame, size_t count);
+
+public:
+    // Throws std::runtime_error if any of the error bounds is outside [minimumErrorBound, maximumErrorBound]
+    TrajectoryEncoder(uint32_t fields, const TrajectoryCodecSettings &settings);
+
+    // Appends one encoded frame to out; frame holds count particles in the writer layout
+    void encode(const float *frame, size_t count, std::vector<uint8_t> &out);
+
+    // Makes the next frame a keyframe
+    void reset() { forceKeyframe = true; }
+};
+
+class TrajectoryDecoder
+{
+private:
+    std::vector<TrajectoryChannel> channels;
+    size_t particleCount;
+    uint32_t framesSinceKeyframe;
+    bool haveKeyframe;
+
+public:
+    explicit TrajectoryDecoder(uint32_t fields);
+
+    static bool isKeyframe(const uint8_t *payload, size_t bytes);
+
+    static uint64_t frameParticleCount(const uint8_t *payload, size_t bytes);
+
+    // Decodes one payload into frame (writer layout). The frames after a keyframe must be decoded in
+    // order, starting from it. Throws std::runtime_error on corrupt data or a frame without its keyframe.
+    void decode(const uint8_t *payload, size_t bytes, std::vector<float> &frame);
+
+    // Drops the keyframe state, e.g. before seeking
+    void reset() { haveKeyframe = false; }
+};
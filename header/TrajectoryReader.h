@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+#include "TrajectoryWriter.h"
+#include "TrajectoryCodec.h"
+
+struct TrajectoryFrameInfo
+{
+    uint64_t payloadOffset; // file offset of the frame's payload
+    uint64_t payloadBytes;
+    uint64_t step;
+    double time;
+    uint64_t particleCount;
+    uint64_t keyframe;      // first frame to decode on the way to this one, itself for raw frames
+    bool compressed;
+};
+
+// Random access to a recorded trajectory. The file is memory mapped and indexed once by walking the
+// chunk headers, so seeking is a lookup and the file is never loaded whole. Pages of frames already
+// read are handed back to the OS and the next frame's pages are prefetched, which keeps the memory
+// use near one frame whatever the file size. A truncated last frame, e.g. from a crashed recording,
+// is left out of the index.
+class TrajectoryReader
+{
+private:
+    const unsigned char *bytes; // whole file mapping, null where mmap is not available
+    size_t byteCount;
+    FILE *file;                 // read on demand instead of mapping (platforms without mmap)
+    std::vector<unsigned char> staging;
+    TrajectoryFileHeader header;
+    std::vector<TrajectoryFrameInfo> frames;
+    TrajectoryDecoder decoder;
+    size_t decodedFrame;        // last frame through the decoder, its state continues from there
+    std::vector<float> decoded;
+    std::vector<float> aligned; // raw frames whose payload is not float aligned in the mapping
+    size_t pinnedFrame;         // frame whose mapped pages back the last returned pointer
+
+    // Pointer to bytes of the file, valid until the next call
+    const unsigned char *fetch(uint64_t offset, size_t count);
+
+    // Drops the mapped pages of a frame; they are read from the file again if needed
+    void releasePages(size_t index);
+
+    void prefetchPages(size_t index);
+
+    void buildIndex();
+
+    void release();
+
+public:
+    // Throws std::runtime_error on missing files, bad magic or a newer version
+    explicit TrajectoryReader(const char *filename);
+
+    ~TrajectoryReader();
+
+    TrajectoryReader(const TrajectoryReader &) = delete;
+    TrajectoryReader &operator=(const TrajectoryReader &) = delete;
+
+    const TrajectoryFileHeader &getHeader() const { return header; }
+
+    uint32_t getFields() const { return header.fields; }
+
+    size_t getFrameCount() const { return frames.size(); }
+
+    const TrajectoryFrameInfo &getFrame(size_t index) const { return frames[index]; }
+
+    // Last frame recorded at or before time, the first frame for earlier times
+    size_t findFrame(double time) const;
+
+    // Frame floats in the writer layout. Raw frames point into the mapping, compressed ones are decoded
+    // from their keyframe unless the previous call left the decoder just before them. Valid until the
+    // next call. Throws std::runtime_error on corrupt frames.
+    const float *readFrame(size_t index);
+};
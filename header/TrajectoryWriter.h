@@ -0,0 +1,126 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+#include "Particle.h"
+#include "TrajectoryCodec.h"
+
+// Trajectory file: a TrajectoryFileHeader followed by one chunk per frame. A chunk is a
+// TrajectoryFrameHeader and payloadBytes of float arrays in field order: positions (x, y pairs),
+// velocities (x, y pairs), densities. Compressed files hold TrajectoryCodec payloads in "CFRM" chunks
+// instead. Readers skip unknown chunk tags by payloadBytes.
+struct TrajectoryFileHeader
+{
+    static constexpr uint32_t currentVersion = 1;
+    static constexpr uint32_t rawCodec = 0;
+    static constexpr uint32_t compressedCodec = 1;
+
+    char magic[8]; // "SPHTRAJ"
+    uint32_t version;
+    uint32_t byteOrder; // 0x01020304 as written
+    uint32_t fields;    // TrajectoryField bits
+    uint32_t interval;  // steps between frames
+    uint32_t codec;
+    float errorBound;   // position bound of the compressed codec, relative to the positions' range
+};
+
+enum TrajectoryField : uint32_t
+{
+    TrajectoryPositions = 1u << 0,
+    TrajectoryVelocities = 1u << 1,
+    TrajectoryDensities = 1u << 2
+};
+
+struct TrajectoryFrameHeader
+{
+    static constexpr uint32_t frameTag = 0x4D415246;           // "FRAM"
+    static constexpr uint32_t compressedFrameTag = 0x4D524643; // "CFRM"
+
+    uint32_t tag;
+    uint32_t reserved;
+    uint64_t payloadBytes;
+    uint64_t step;
+    double time;
+    uint64_t particleCount;
+};
+
+struct TrajectoryStats
+{
+    uint64_t framesOffered = 0; // record() calls on a frame step
+    uint64_t framesWritten = 0;
+    uint64_t framesDropped = 0; // both staging buffers were still waiting for the disk
+    uint64_t bytesWritten = 0;
+    uint64_t rawBytes = 0;      // frame payloads before compression, for the compression ratio
+    double encodeSeconds = 0.0; // time the I/O thread spent compressing
+    double writeSeconds = 0.0;  // time the I/O thread spent in fwrite
+    bool writeFailed = false;   // the disk refused a write, later frames are dropped
+};
+
+// Records every interval-th step on a background I/O thread. record() copies the frame into one of two
+// staging buffers and returns; if the writer still holds both, the frame is dropped and counted rather
+// than stalling the simulation. Staging buffers are reused, so steady recording does not allocate.
+// Compression runs on the I/O thread, so it only costs the simulation when it falls behind.
+class TrajectoryWriter
+{
+private:
+    enum class SlotState
+    {
+        Free,
+        Filled,
+        Writing
+    };
+
+    struct Slot
+    {
+        std::vector<float> data;
+        TrajectoryFrameHeader header;
+        SlotState state = SlotState::Free;
+        uint64_t sequence = 0;
+    };
+
+    FILE *file;
+    uint32_t fields;
+    uint32_t interval;
+    Slot slots[2];
+    uint64_t nextSequence;
+    bool stopping;
+    TrajectoryStats stats;
+    mutable std::mutex mutex;
+    std::condition_variable filled;
+    std::thread writer;
+    std::unique_ptr<TrajectoryEncoder> encoder; // null for raw frames, used by the I/O thread only
+    std::vector<uint8_t> encoded;
+
+    void writerLoop();
+
+    template <typename Real>
+    void pack(Slot &slot, const std::vector<BasicParticle<Real>> &particles) const;
+
+public:
+    // Throws std::runtime_error if the file cannot be created. Pass codec settings to compress the frames.
+    TrajectoryWriter(const char *filename, uint32_t interval, uint32_t fields = TrajectoryPositions | TrajectoryVelocities | TrajectoryDensities,
+                     const TrajectoryCodecSettings *compression = nullptr);
+
+    // Same as finish()
+    ~TrajectoryWriter();
+
+    TrajectoryWriter(const TrajectoryWriter &) = delete;
+    TrajectoryWriter &operator=(const TrajectoryWriter &) = delete;
+
+    // Call every step; only steps that are multiples of the interval are staged
+    template <typename Real>
+    void record(const std::vector<BasicParticle<Real>> &particles, uint64_t step, double time);
+
+    TrajectoryStats getStats() const;
+
+    // Writes what is still staged, closes the file and returns the final stats. Frames recorded
+    // afterwards are dropped; calling it again just returns the stats.
+    TrajectoryStats finish();
+};
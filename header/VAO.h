@@ -10,6 +10,8 @@ class VAO
         VAO();
 
         void LinkVBO(VBO& VBO, GLuint layout);
+        // divisor 1 advances the attribute once per instance instead of per vertex
+        void LinkAttrib(VBO& VBO, GLuint layout, GLint components, GLsizei stride, GLsizeiptr offset, GLuint divisor);
         void Bind();
         void Unbind();
         void Delete();
@@ -8,6 +8,9 @@ class VBO
         GLuint ID;
         VBO(GLfloat* vertices, GLsizeiptr size);
 
+        // Replaces the contents, e.g. with a new frame every draw
+        void Update(const GLvoid* data, GLsizeiptr size);
+
         void Bind();
         void Unbind();
         void Delete();
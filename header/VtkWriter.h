@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#include "Particle.h"
+#include "Simulation.h"
+
+class ThreadPool;
+
+// VTK XML output for ParaView. Every exported step is a .pvtp file that references one .vtp piece per
+// particle range, and the pieces are written in parallel on the pool's threads. A .pvd collection lists
+// the steps with their times, so ParaView opens the whole run as a time series.
+// Pieces hold raw little-endian appended arrays: Points, velocity, density and pressure, plus one vertex
+// cell per particle so they render without a glyph filter.
+class VtkWriter
+{
+private:
+    std::string directory; // prefix of every file, including the separator
+    std::string name;      // basename without directory, files are referenced relative to the .pvd
+    ThreadPool *pool;      // optional, not owned
+    size_t pieceCount;     // 0: one per pool thread
+    std::vector<std::pair<double, std::string>> steps; // time and .pvtp of every exported step
+
+    void writeCollection() const;
+
+public:
+    // basename is a path prefix, e.g. "output/run" gives output/run.pvd, output/run_000100.pvtp and
+    // output/run_000100_0.vtp; the directory must exist. The pool must outlive the writer; pass nullptr
+    // to write on the calling thread.
+    explicit VtkWriter(const char *basename, ThreadPool *pool = nullptr, size_t pieceCount = 0);
+
+    // Writes the pieces, the step's .pvtp and the updated .pvd. Pressure uses the solver's equation of
+    // state from parameters. Throws std::runtime_error if a file cannot be written.
+    template <typename Real>
+    void writeStep(const std::vector<BasicParticle<Real>> &particles, const SimulationParameters &parameters, uint64_t step, double time);
+
+    size_t getStepCount() const { return steps.size(); }
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// Chase-Lev work-stealing deque of task ids. The owning worker pushes and pops at the bottom
+// without locks; other workers steal from the top with a single compare-and-swap.
+// Capacity is fixed per reset(), callers size it for everything pushed before the next reset.
+class WorkStealingDeque
+{
+private:
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    std::unique_ptr<std::atomic<uint32_t>[]> buffer;
+    size_t capacity;
+    int64_t mask;
+
+public:
+    WorkStealingDeque();
+
+    // Empties the deque and makes room for at least minimumCapacity pushes. Not thread safe.
+    void reset(size_t minimumCapacity);
+
+    // Owner only
+    void push(uint32_t value);
+
+    // Owner only, newest first
+    bool pop(uint32_t &value);
+
+    // Any thread, oldest first. Fails if empty or if another thread won the race.
+    bool steal(uint32_t &value);
+};
@@ -3,6 +3,8 @@
 #include <GLFW/glfw3.h>
 #include <vector>
 #include <cmath>
+#include <cstdio>
+#include <string>
 #include <glm/glm.hpp>
 #include <glm/ext/matrix_transform.hpp>
 
@@ -10,7 +12,12 @@
 #include "header/VAO.h"
 #include "header/VBO.h"
 #include "header/EBO.h"
-#include "header/Particle.h"
+#include "header/Simulation.h"
+#include "header/Checkpoint.h"
+#include "header/TrajectoryWriter.h"
+#include "header/TrajectoryReader.h"
+#include "header/VtkWriter.h"
+#include "header/Scene.h"
 
 std::vector<float> generateCircleVertices(const glm::vec2 &center, float radius, int numSegments)
 {
@@ -28,14 +35,195 @@ std::vector<float> generateCircleVertices(const glm::vec2 &center, float radius,
 	return vertices;
 }
 
-int main()
+// Replays a recorded trajectory instead of simulating. Frames are read from the mapped file and streamed
+// into an instanced particle VBO, so memory use stays flat however long the recording is.
+// Space pauses, Left/Right step while paused and set the direction while playing, Up/Down double or
+// halve the speed, Home/End jump to the ends and dragging with the left mouse button scrubs.
+int playTrajectory(GLFWwindow *window, int windowWidth, const char *filename, VBO &circleVBO, GLsizei circleVertexCount, float visualRadius)
 {
+	std::unique_ptr<TrajectoryReader> reader;
+	try
+	{
+		reader.reset(new TrajectoryReader(filename));
+	}
+	catch (const std::exception &error)
+	{
+		std::cout << error.what() << std::endl;
+		return -1;
+	}
+	const uint32_t fields = reader->getFields();
+	if (reader->getFrameCount() == 0 || !(fields & TrajectoryPositions))
+	{
+		std::cout << "No frames with positions in " << filename << std::endl;
+		return -1;
+	}
+	const size_t lastFrame = reader->getFrameCount() - 1;
+	const double startTime = reader->getFrame(0).time;
+	const double endTime = reader->getFrame(lastFrame).time;
+
+	Shader particleShader("../../Resource Files/Shaders/instanced.vert", "../../Resource Files/Shaders/instanced.frag");
+	VAO particleVAO;
+	particleVAO.Bind();
+	particleVAO.LinkVBO(circleVBO, 0);
+	particleVAO.Unbind();
+	// positions then velocities, straight from the frame layout
+	VBO frameVBO(nullptr, 0);
+
+	particleShader.Activate();
+	particleShader.setMat4("model", glm::scale(glm::mat4(1.0f), glm::vec3(visualRadius, visualRadius, 1.0f)));
+	particleShader.setVec3("slowColor", glm::vec3(0.0f, 0.0f, 1.0f));
+	particleShader.setVec3("fastColor", glm::vec3(1.0f, 0.0f, 0.0f));
+
+	double playTime = startTime;
+	double speed = 1.0; // recorded seconds per real second
+	bool forward = true;
+	bool paused = false;
+	size_t shown = lastFrame + 1;
+	GLsizei instanceCount = 0;
+	double lastClock = glfwGetTime();
+	bool spaceHeld = false, leftHeld = false, rightHeld = false, upHeld = false, downHeld = false;
+	auto pressed = [&](int key, bool &held)
+	{
+		bool down = glfwGetKey(window, key) == GLFW_PRESS;
+		bool edge = down && !held;
+		held = down;
+		return edge;
+	};
+
+	while (!glfwWindowShouldClose(window))
+	{
+		double clock = glfwGetTime();
+		double elapsed = clock - lastClock;
+		lastClock = clock;
+
+		size_t current = reader->findFrame(playTime);
+		if (pressed(GLFW_KEY_SPACE, spaceHeld))
+			paused = !paused;
+		bool left = pressed(GLFW_KEY_LEFT, leftHeld);
+		bool right = pressed(GLFW_KEY_RIGHT, rightHeld);
+		if (paused && (left || right))
+		{
+			current = left ? (current > 0 ? current - 1 : 0) : std::min(current + 1, lastFrame);
+			playTime = reader->getFrame(current).time;
+		}
+		else if (left || right)
+			forward = right;
+		if (pressed(GLFW_KEY_UP, upHeld))
+			speed = std::min(speed * 2.0, 1024.0);
+		if (pressed(GLFW_KEY_DOWN, downHeld))
+			speed = std::max(speed * 0.5, 1.0 / 64.0);
+		if (glfwGetKey(window, GLFW_KEY_HOME) == GLFW_PRESS)
+			playTime = startTime;
+		if (glfwGetKey(window, GLFW_KEY_END) == GLFW_PRESS)
+			playTime = endTime;
+
+		if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+		{
+			double mouseX, mouseY;
+			glfwGetCursorPos(window, &mouseX, &mouseY);
+			playTime = startTime + std::min(std::max(mouseX / windowWidth, 0.0), 1.0) * (endTime - startTime);
+		}
+		else if (!paused)
+		{
+			// loops at either end
+			playTime += (forward ? speed : -speed) * elapsed;
+			if (playTime > endTime)
+				playTime = startTime;
+			else if (playTime < startTime)
+				playTime = endTime;
+		}
+
+		size_t target = reader->findFrame(playTime);
+		if (target != shown)
+		{
+			try
+			{
+				const float *frame = reader->readFrame(target);
+				const TrajectoryFrameInfo &info = reader->getFrame(target);
+				const size_t count = static_cast<size_t>(info.particleCount);
+				const bool velocities = (fields & TrajectoryVelocities) != 0;
+				frameVBO.Update(frame, count * (velocities ? 4 : 2) * sizeof(float));
+
+				particleVAO.Bind();
+				particleVAO.LinkAttrib(frameVBO, 1, 2, 2 * sizeof(float), 0, 1);
+				if (velocities)
+					particleVAO.LinkAttrib(frameVBO, 2, 2, 2 * sizeof(float), count * 2 * sizeof(float), 1);
+				else
+				{
+					glDisableVertexAttribArray(2);
+					glVertexAttrib2f(2, 0.0f, 0.0f);
+				}
+				particleVAO.Unbind();
+				instanceCount = static_cast<GLsizei>(count);
+				shown = target;
+
+				char title[128];
+				std::snprintf(title, sizeof(title), "ParticleSim9000 - frame %zu/%zu, step %llu, t = %.3f, %gx%s", target + 1, lastFrame + 1,
+							  static_cast<unsigned long long>(info.step), info.time, forward ? speed : -speed, paused ? " (paused)" : "");
+				glfwSetWindowTitle(window, title);
+			}
+			catch (const std::exception &error)
+			{
+				std::cout << error.what() << std::endl;
+				paused = true;
+				shown = target;
+			}
+		}
+
+		glClearColor(0.07f, 0.13f, 0.17f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		particleShader.Activate();
+		particleVAO.Bind();
+		glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, circleVertexCount, instanceCount);
+
+		glfwSwapBuffers(window);
+		glfwPollEvents();
+	}
+
+	particleVAO.Delete();
+	frameVBO.Delete();
+	particleShader.Delete();
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	// opengl_program [--scene scene.json] [--play trajectory.sphtraj] [checkpoint]
+	const char *sceneFile = nullptr;
+	const char *playFile = nullptr;
+	const char *checkpointArgument = nullptr;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string argument(argv[i]);
+		if (argument == "--scene" && i + 1 < argc)
+			sceneFile = argv[++i];
+		else if (argument == "--play" && i + 1 < argc)
+			playFile = argv[++i];
+		else
+			checkpointArgument = argv[i];
+	}
+
+	// Parameters, initial fluid, solver and output settings; the defaults are the original scene
+	SceneSettings scene;
+	if (sceneFile != nullptr)
+	{
+		try
+		{
+			scene = loadScene(sceneFile);
+		}
+		catch (const std::exception &error)
+		{
+			std::cout << error.what() << std::endl;
+			return -1;
+		}
+	}
+
 	// GLFW init
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	GLFWwindow *window = glfwCreateWindow(800, 800, "ParticleSim9000", NULL, NULL);
+	GLFWwindow *window = glfwCreateWindow(scene.windowWidth, scene.windowHeight, "ParticleSim9000", NULL, NULL);
 	if (window == NULL)
 	{
 		std::cout << "Failed to create GLFW window" << std::endl;
@@ -46,7 +234,7 @@ int main()
 
 	// load GL + functions
 	gladLoadGL();
-	glViewport(0, 0, 800, 800);
+	glViewport(0, 0, scene.windowWidth, scene.windowHeight);
 
 	// Compiles, attaches, and generates shaderprogram.
 	Shader shaderProgram("../../Resource Files/Shaders/default.vert", "../../Resource Files/Shaders/default.frag");
@@ -69,30 +257,210 @@ int main()
 	VAO1.Unbind();
 	VBO1.Unbind();
 
+	// --play <file> replays a recorded trajectory instead of simulating
+	if (playFile != nullptr)
+	{
+		int result = playTrajectory(window, scene.windowWidth, playFile, VBO1, static_cast<GLsizei>(circleVertices.size() / 2), visualRadius);
+		VAO1.Delete();
+		VBO1.Delete();
+		shaderProgram.Delete();
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return result;
+	}
+
 	// Set up the simulation parameters
-	float mass = 1.0f;					 // Mass of the particles
-	float damping = 1.0f;				 // Damping multiplier
-	float timeStep = 0.003f;			 // Time step for the simulation
-	float radius = 0.05f;				 // Radius of the particles
-	float targetDensity = 1.0f;			 // Target density for the particles
-	float pressureMultiplier = 10000.0f; // Pressure multiplier
-	float mouseForce = 0.2f;			 // Mouse force multiplier
+	float mass = scene.mass;							   // Mass of the particles
+	float damping = scene.damping;						   // Damping multiplier
+	float timeStep = scene.timeStep;					   // Time step for the simulation
+	float radius = scene.radius;						   // Radius of the particles
+	float targetDensity = scene.targetDensity;			   // Target density for the particles
+	float pressureMultiplier = scene.pressureMultiplier; // Pressure multiplier
+	float mouseForce = scene.mouseForce;				   // Mouse force multiplier
+	bool periodicX = scene.periodicX;
+	bool periodicY = scene.periodicY;
+
+	// A checkpoint passed on the command line is resumed with its solver settings; F5 saves to it, F9 reloads it
+	const std::string checkpointFile = checkpointArgument != nullptr ? checkpointArgument : scene.checkpointFile;
+	std::unique_ptr<MappedCheckpoint> resume;
+	if (checkpointArgument != nullptr)
+	{
+		try
+		{
+			resume.reset(new MappedCheckpoint(checkpointFile.c_str()));
+			// a double or compact particle layout and a corrupt RNG state throw here, before any
+			// setting is taken from the file, so the scene starts fresh instead
+			resume->particles<float>();
+			resume->getRng();
+			SimulationParameters saved = resume->getParameters();
+			radius = saved.radius;
+			mass = saved.mass;
+			damping = saved.damping;
+			targetDensity = saved.targetDensity;
+			pressureMultiplier = saved.pressureMultiplier;
+			periodicX = saved.periodicX;
+			periodicY = saved.periodicY;
+		}
+		catch (const std::exception &error)
+		{
+			std::cout << error.what() << std::endl;
+			resume.reset();
+		}
+	}
 
-	Simulation simulation = Simulation(radius, mass, damping, targetDensity, pressureMultiplier);
+	std::unique_ptr<SimulationBase> simulation =
+		scene.mixedPrecision ? makeSimulation<MixedPrecision>(scene.kernel, scene.integrator, scene.boundary, radius, mass, damping, targetDensity, pressureMultiplier)
+							 : makeSimulation(scene.kernel, scene.integrator, scene.boundary, radius, mass, damping, targetDensity, pressureMultiplier);
+	simulation->setPeriodic(periodicX, periodicY);
+
+	std::unique_ptr<ThreadPool> pool;
+	if (scene.threads != 1)
+	{
+		pool.reset(new ThreadPool(scene.threads, scene.numa));
+		simulation->setThreadPool(pool.get());
+	}
+
+	// obstacles and containers are baked once over the simulation domain
+	std::unique_ptr<SignedDistanceField> field;
+	if (!scene.obstacles.empty() || !scene.containers.empty())
+	{
+		const BoundarySettings &domain = simulation->getBoundary();
+		field.reset(new SignedDistanceField(domain.domainMin, domain.domainMax, scene.sdfResolution));
+		try
+		{
+			field->bakePolylines(scene.containers, scene.obstacles);
+			simulation->setBoundaryField(field.get());
+		}
+		catch (const std::exception &error)
+		{
+			// geometry that leaves no fluid region runs in the plain box instead
+			std::cout << error.what() << std::endl;
+			field.reset();
+		}
+	}
+
+	std::mt19937 rng(scene.seed);
+	std::vector<Particle> particles = generateScene(scene, rng);
+	double simulationTime = 0.0;
+	uint64_t stepCount = 0;
+
+	// everything that can throw runs before the first change, so a failed restore keeps the running state
+	auto restore = [&](const MappedCheckpoint &checkpoint)
+	{
+		std::mt19937 savedRng = checkpoint.getRng();
+		checkpoint.restore(particles);
+		rng = savedRng;
+		simulationTime = checkpoint.getTime();
+		stepCount = checkpoint.getStep();
+	};
+	if (resume)
+	{
+		restore(*resume);
+		resume.reset();
+	}
+	bool saveHeld = false;
+	bool loadHeld = false;
+
+	// R starts and stops recording to the scene's trajectory file
+	std::unique_ptr<TrajectoryWriter> recorder;
+	bool recordHeld = false;
+	auto startRecording = [&]()
+	{
+		try
+		{
+			recorder.reset(new TrajectoryWriter(scene.trajectoryFile.c_str(), scene.trajectoryInterval,
+												TrajectoryPositions | TrajectoryVelocities | TrajectoryDensities,
+												scene.compressTrajectory ? &scene.compression : nullptr));
+		}
+		catch (const std::exception &error)
+		{
+			std::cout << error.what() << std::endl;
+		}
+	};
+	auto stopRecording = [&]()
+	{
+		// final stats, including the frames that were still staged
+		TrajectoryStats stats = recorder->finish();
+		recorder.reset();
+		std::cout << "Recorded " << stats.framesWritten << " frames, dropped " << stats.framesDropped
+				  << ", compressed " << (stats.bytesWritten > 0 ? double(stats.rawBytes) / stats.bytesWritten : 0.0) << "x"
+				  << (stats.writeFailed ? " (write failed)" : "") << std::endl;
+	};
+	if (scene.recordAtStart)
+		startRecording();
+
+	// V exports the current step for ParaView, the scene can also export every vtkInterval steps
+	VtkWriter vtkWriter(scene.vtkBasename.c_str(), pool.get());
+	bool exportHeld = false;
 
-	std::vector<Particle> particles = generateParticles(500, -0.5, 0.5, -0.5, 0.5);
 	// Main while loop
 	while (!glfwWindowShouldClose(window))
 	{
+		bool save = glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS;
+		bool load = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
+		if (save && !saveHeld)
+		{
+			try
+			{
+				writeCheckpoint(checkpointFile.c_str(), particles, simulation->getParameters(), simulationTime, stepCount, rng);
+			}
+			catch (const std::exception &error)
+			{
+				std::cout << error.what() << std::endl;
+			}
+		}
+		if (load && !loadHeld)
+		{
+			try
+			{
+				restore(MappedCheckpoint(checkpointFile.c_str()));
+			}
+			catch (const std::exception &error)
+			{
+				std::cout << error.what() << std::endl;
+			}
+		}
+		saveHeld = save;
+		loadHeld = load;
+
+		bool record = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+		if (record && !recordHeld)
+		{
+			if (recorder)
+				stopRecording();
+			else
+				startRecording();
+		}
+		recordHeld = record;
+
+		bool exportStep = glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS;
+		bool exportDue = scene.vtkInterval > 0 && stepCount % scene.vtkInterval == 0;
+		if ((exportStep && !exportHeld) || exportDue)
+		{
+			try
+			{
+				vtkWriter.writeStep(particles, simulation->getParameters(), stepCount, simulationTime);
+			}
+			catch (const std::exception &error)
+			{
+				std::cout << error.what() << std::endl;
+			}
+		}
+		exportHeld = exportStep;
+
 		// Mouse cursor
 		double mouseX, mouseY;
 		glfwGetCursorPos(window, &mouseX, &mouseY);
 		bool attract = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
 		bool repel = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
 		float finalMouseForce = mouseForce * attract - mouseForce * repel;
-		glm::vec3 mouseVector((2.0f * mouseX) / 800 - 1.0f, 1.0f - (2.0f * mouseY) / 800, finalMouseForce);
+		glm::vec3 mouseVector((2.0f * mouseX) / scene.windowWidth - 1.0f, 1.0f - (2.0f * mouseY) / scene.windowHeight, finalMouseForce);
 
-		simulation.updateParticles(particles, timeStep, mouseVector);
+		simulation->updateParticles(particles, timeStep, mouseVector);
+		simulationTime += timeStep;
+		++stepCount;
+		if (recorder)
+			recorder->record(particles, stepCount, simulationTime);
 
 		// Clear BG
 		glClearColor(0.07f, 0.13f, 0.17f, 1.0f);
@@ -123,6 +491,9 @@ int main()
 		glfwPollEvents();
 	}
 
+	if (recorder)
+		stopRecording();
+
 	// Delete objects
 	VAO1.Delete();
 	VBO1.Delete();
@@ -0,0 +1,54 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "header/Ensemble.h"
+
+// Headless parameter sweep: ./sph_ensemble sweep.txt results.csv [threads]
+int main(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		std::cerr << "usage: " << argv[0] << " <sweep file> <results.csv> [threads]" << std::endl;
+		return 1;
+	}
+
+	std::vector<RunParameters> runs;
+	try
+	{
+		runs = loadSweep(argv[1]);
+	}
+	catch (const std::exception &error)
+	{
+		std::cerr << error.what() << std::endl;
+		return 1;
+	}
+
+	FILE *csv = fopen(argv[2], "w");
+	if (csv == nullptr)
+	{
+		std::cerr << "Could not open " << argv[2] << std::endl;
+		return 1;
+	}
+	fprintf(csv, "run,particles,pressureMultiplier,targetDensity,damping,radius,mass,steps,deltaTime,seed,"
+				 "kineticEnergy,meanDensity,densityError,maxSpeed,meanHeight,msPerStep,finite,failed\n");
+
+	const unsigned threads = argc > 3 ? static_cast<unsigned>(std::atoi(argv[3])) : 0;
+	size_t finished = 0;
+	runEnsemble(runs, threads, [&](size_t run, const RunMetrics &metrics)
+				{
+		const RunParameters &p = runs[run];
+		fprintf(csv, "%zu,%d,%g,%g,%g,%g,%g,%d,%g,%u,%.9g,%.9g,%.9g,%.9g,%.9g,%.4f,%d,%d\n", run, p.particles, p.pressureMultiplier,
+				p.targetDensity, p.damping, p.radius, p.mass, p.steps, p.deltaTime, p.seed, metrics.kineticEnergy, metrics.meanDensity,
+				metrics.densityError, metrics.maxSpeed, metrics.meanHeight, metrics.msPerStep, metrics.finite ? 1 : 0,
+				metrics.failed ? 1 : 0);
+		// rows are in completion order, flushed so an interrupted sweep keeps what it has
+		fflush(csv);
+		std::cout << "\r" << ++finished << "/" << runs.size() << " runs" << std::flush; });
+	std::cout << std::endl;
+
+	fclose(csv);
+	return 0;
+}
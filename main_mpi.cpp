@@ -0,0 +1,66 @@
+#include <mpi.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "header/DistributedSimulation.h"
+
+// Headless distributed run: mpirun -np 4 ./sph_mpi [particles] [steps] [boundary: box|periodic]
+int main(int argc, char **argv)
+{
+	MPI_Init(&argc, &argv);
+	{
+		const int particleCount = argc > 1 ? std::atoi(argv[1]) : 20000;
+		const int steps = argc > 2 ? std::atoi(argv[2]) : 500;
+		const bool periodic = argc > 3 && std::string(argv[3]) == "periodic";
+		const float deltaTime = 0.003f;
+
+		auto solver = makeSimulation(KernelType::Poly6Spiky, IntegratorType::Verlet, periodic ? BoundaryType::Periodic : BoundaryType::Box,
+									 0.05f, 1.0f, 1.0f, 1.0f, 10000.0f);
+		DistributedSimulation simulation(MPI_COMM_WORLD, std::move(solver));
+
+		// every rank generates the same set and keeps its slab
+		std::mt19937 rng(1);
+		std::vector<Particle> particles = generateParticles(particleCount, -0.5f, 0.5f, -0.5f, 0.5f, rng);
+		simulation.distribute(particles);
+
+		std::vector<InteractionField> fields;
+		auto start = std::chrono::steady_clock::now();
+		for (int step = 1; step <= steps; ++step)
+		{
+			simulation.step(particles, deltaTime, fields);
+
+			if (step % 100 == 0 || step == steps)
+			{
+				unsigned long long counts[2] = {particles.size(), simulation.getGhostCount()};
+				unsigned long long totals[2];
+				unsigned long long busiest;
+				MPI_Reduce(counts, totals, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+				MPI_Reduce(counts, &busiest, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+				if (simulation.getRank() == 0)
+				{
+					double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / step;
+					printf("step %d particles %llu ghosts %llu imbalance %.3f rebalances %llu %.3f ms/step\n", step, totals[0], totals[1],
+						   busiest * simulation.getRankCount() / double(totals[0]), (unsigned long long)simulation.getRebalanceCount(), ms);
+				}
+			}
+		}
+
+		std::vector<Particle> all;
+		simulation.gather(particles, all, 0);
+		if (simulation.getRank() == 0)
+		{
+			double sumX = 0.0, sumY = 0.0;
+			for (const auto &particle : all)
+			{
+				sumX += particle.position.x;
+				sumY += particle.position.y;
+			}
+			printf("mean position %.6f %.6f\n", sumX / all.size(), sumY / all.size());
+		}
+	}
+	MPI_Finalize();
+	return 0;
+}
@@ -0,0 +1,101 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "header/Simulation.h"
+
+// Speed and accuracy of the particle precisions: ./sph_precision [particles] [steps]
+// Every precision starts from the same float particles and is compared against the double run after the
+// last step. The far case moves the block away from the origin, where absolute float positions are coarse.
+// Mixed precision is measured on the rounded float copies in the particle array, not on its cell offsets.
+
+namespace
+{
+	const float radius = 0.05f;
+	const float mass = 1.0f;
+	const float damping = 1.0f;
+	const float targetDensity = 1.0f;
+	const float pressureMultiplier = 10000.0f;
+	const float deltaTime = 0.003f;
+
+	template <typename Real>
+	struct Run
+	{
+		std::vector<BasicParticle<Real>> particles;
+		double msPerStep;
+	};
+
+	template <typename Precision>
+	Run<typename Precision::Storage> simulate(BoundaryType boundary, const std::vector<Particle> &start, int steps)
+	{
+		typedef BasicParticle<typename Precision::Storage> ParticleType;
+		Run<typename Precision::Storage> run;
+		run.particles.reserve(start.size());
+		for (const Particle &particle : start)
+			run.particles.push_back(ParticleType(particle));
+
+		auto simulation = makeSimulation<Precision>(KernelType::Poly6Spiky, IntegratorType::Verlet, boundary,
+													radius, mass, damping, targetDensity, pressureMultiplier);
+		const std::vector<InteractionField> fields;
+		// one untimed step so the scratch buffers are sized
+		simulation->updateParticles(run.particles, deltaTime, fields);
+		auto begin = std::chrono::steady_clock::now();
+		for (int step = 1; step < steps; ++step)
+			simulation->updateParticles(run.particles, deltaTime, fields);
+		run.msPerStep = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count() / std::max(steps - 1, 1);
+		return run;
+	}
+
+	template <typename Real>
+	void report(const char *name, const Run<Real> &run, const Run<double> &reference)
+	{
+		double positionError = 0.0;
+		double densityError = 0.0;
+		for (size_t i = 0; i < run.particles.size(); ++i)
+		{
+			const BasicParticle<double> &exact = reference.particles[i];
+			positionError += glm::length(glm::dvec2(run.particles[i].position) - exact.position);
+			densityError += std::abs(double(run.particles[i].density) - exact.density) / exact.density;
+		}
+		const double count = static_cast<double>(run.particles.size());
+		printf("  %-7s %10.3f %16.3e %16.3e\n", name, run.msPerStep, positionError / count, densityError / count);
+	}
+
+	void compare(const char *title, BoundaryType boundary, const std::vector<Particle> &start, int steps)
+	{
+		printf("%s, %zu particles, %d steps\n", title, start.size(), steps);
+		printf("  %-7s %10s %16s %16s\n", "", "ms/step", "position error", "density error");
+		const Run<double> reference = simulate<DoublePrecision>(boundary, start, steps);
+		report("double", reference, reference);
+		report("single", simulate<SinglePrecision>(boundary, start, steps), reference);
+		report("mixed", simulate<MixedPrecision>(boundary, start, steps), reference);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const int particleCount = argc > 1 ? std::atoi(argv[1]) : 2000;
+	const int steps = argc > 2 ? std::atoi(argv[2]) : 20;
+	if (particleCount <= 0 || steps <= 0)
+	{
+		std::cerr << "usage: " << argv[0] << " [particles > 0] [steps > 0]" << std::endl;
+		return 1;
+	}
+
+	// a lattice, so no two particles round to the same float position far from the origin
+	const std::vector<Particle> block = generateUniformGridParticles(particleCount, -0.5f, 0.5f, -0.5f, 0.5f);
+	compare("Box around the origin", BoundaryType::Box, block, steps);
+
+	// the open boundary has no walls, so the block can sit anywhere
+	const float far = 4096.0f;
+	std::vector<Particle> shifted;
+	shifted.reserve(block.size());
+	for (const Particle &particle : block)
+		shifted.push_back(Particle(particle.position + glm::vec2(far), glm::vec2(0.0f)));
+	printf("\n");
+	compare("Open boundary at (4096, 4096)", BoundaryType::Open, shifted, steps);
+	return 0;
+}
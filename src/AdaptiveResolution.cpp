@@ -0,0 +1,161 @@
+#include "AdaptiveResolution.h"
+
+#include <cmath>
+#include <limits>
+
+AdaptiveResolution::AdaptiveResolution(float radius, int levels)
+    : radius(radius), minSizeScale(std::ldexp(1.0f, -levels)), splitDensityRatio(0.75f), mergeDensityRatio(0.95f),
+      boundaryField(nullptr), obstacleBand(0.0f), maxParticles(std::numeric_limits<size_t>::max()), hash(radius)
+{
+}
+
+void AdaptiveResolution::setBoundaryField(const SignedDistanceField *field, float band)
+{
+    boundaryField = field;
+    obstacleBand = band;
+}
+
+void AdaptiveResolution::setMaxParticles(size_t count)
+{
+    maxParticles = count;
+}
+
+bool AdaptiveResolution::nearSurface(const Particle &particle, float meanDensity) const
+{
+    if (particle.density < splitDensityRatio * meanDensity)
+        return true;
+    if (boundaryField)
+    {
+        float distance;
+        glm::vec2 normal;
+        boundaryField->sample(particle.position, distance, normal);
+        return distance < obstacleBand;
+    }
+    return false;
+}
+
+// hysteresis between the split and merge thresholds keeps particles from flickering between levels
+bool AdaptiveResolution::inBulk(const Particle &particle, float meanDensity) const
+{
+    if (particle.density < mergeDensityRatio * meanDensity)
+        return false;
+    if (boundaryField)
+    {
+        float distance;
+        glm::vec2 normal;
+        boundaryField->sample(particle.position, distance, normal);
+        return distance > 2.0f * obstacleBand;
+    }
+    return true;
+}
+
+void AdaptiveResolution::split(std::vector<Particle> &particles, float meanDensity)
+{
+    const size_t count = particles.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (particles.size() + 3 > maxParticles)
+            break;
+        if (particles[i].sizeScale * 0.5f < minSizeScale * 0.99f || !nearSurface(particles[i], meanDensity))
+            continue;
+
+        // children on a small diagonal cross around the parent, sharing its velocity
+        const Particle parent = particles[i];
+        const float offset = 0.25f * radius * parent.sizeScale * 0.70710678f;
+        const glm::vec2 offsets[4] = {{-offset, -offset}, {offset, -offset}, {-offset, offset}, {offset, offset}};
+        for (int c = 0; c < 4; ++c)
+        {
+            Particle child = parent;
+            child.sizeScale = parent.sizeScale * 0.5f;
+            child.position += offsets[c];
+            child.setPrevious(parent.previous() + offsets[c]);
+            if (c == 0)
+                particles[i] = child;
+            else
+                particles.push_back(child);
+        }
+    }
+}
+
+void AdaptiveResolution::merge(std::vector<Particle> &particles, float meanDensity)
+{
+    positions.resize(particles.size());
+    for (size_t i = 0; i < particles.size(); ++i)
+        positions[i] = particles[i].position;
+    hash.build(positions.data(), positions.size());
+    removed.assign(particles.size(), 0);
+
+    for (uint32_t i = 0; i < particles.size(); ++i)
+    {
+        Particle &particle = particles[i];
+        if (removed[i] || particle.sizeScale >= 1.0f || !inBulk(particle, meanDensity))
+            continue;
+
+        // closest bulk partner whose combined mass does not exceed a base particle
+        const float massI = particle.sizeScale * particle.sizeScale;
+        const float searchRadius = 0.5f * radius * particle.sizeScale;
+        uint32_t partner = i;
+        float bestDistance = searchRadius;
+        hash.forEachNeighbor(particle.position, [&](uint32_t j, const glm::vec2 &offset)
+        {
+            if (j == i || removed[j])
+                return;
+            const Particle &other = particles[j];
+            float distance = glm::length(offset);
+            if (distance < bestDistance && massI + other.sizeScale * other.sizeScale <= 1.0001f && inBulk(other, meanDensity))
+            {
+                bestDistance = distance;
+                partner = j;
+            }
+        });
+        if (partner == i)
+            continue;
+
+        // merge conserving mass and momentum, the merged particle sits at the centre of mass
+        Particle &other = particles[partner];
+        const float massJ = other.sizeScale * other.sizeScale;
+        const float total = massI + massJ;
+        const float wi = massI / total;
+        const float wj = massJ / total;
+        const glm::vec2 previous = particle.previous() * wi + other.previous() * wj;
+        particle.position = particle.position * wi + other.position * wj;
+        particle.setPrevious(previous);
+        particle.velocity = particle.velocity * wi + other.velocity * wj;
+        particle.density = particle.density * wi + other.density * wj;
+        particle.sizeScale = std::sqrt(std::min(total, 1.0f));
+        removed[partner] = 1;
+    }
+
+    // compact in place, keeping order
+    size_t write = 0;
+    for (size_t read = 0; read < particles.size(); ++read)
+    {
+        if (!removed[read])
+        {
+            if (write != read)
+                particles[write] = particles[read];
+            ++write;
+        }
+    }
+    particles.erase(particles.begin() + write, particles.end());
+}
+
+void AdaptiveResolution::refine(std::vector<Particle> &particles)
+{
+    if (particles.empty())
+        return;
+
+    // mass weighted mean density, so thresholds do not depend on the mix of levels
+    float densitySum = 0.0f;
+    float massSum = 0.0f;
+    for (const auto &particle : particles)
+    {
+        float m = particle.sizeScale * particle.sizeScale;
+        densitySum += particle.density * m;
+        massSum += m;
+    }
+    const float meanDensity = densitySum / massSum;
+
+    split(particles, meanDensity);
+    merge(particles, meanDensity);
+}
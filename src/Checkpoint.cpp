@@ -0,0 +1,195 @@
+#include "Checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char magicBytes[8] = {'S', 'P', 'H', 'C', 'K', 'P', 'T', '\0'};
+    constexpr uint32_t byteOrderMark = 0x01020304;
+    constexpr uint64_t particleAlignment = 64;
+
+#ifdef SPH_COMPACT_PARTICLES
+    constexpr uint32_t compactBuild = 1;
+#else
+    constexpr uint32_t compactBuild = 0;
+#endif
+
+    uint64_t alignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+template <typename Real>
+void writeCheckpoint(const char *filename, const std::vector<BasicParticle<Real>> &particles, const SimulationParameters &parameters,
+                     double time, uint64_t step, const std::mt19937 &rng)
+{
+    static_assert(std::is_trivially_copyable<BasicParticle<Real>>::value, "particles are written as raw bytes");
+
+    std::ostringstream rngText;
+    rngText << rng;
+    const std::string rngState = rngText.str();
+
+    CheckpointHeader header = {};
+    std::memcpy(header.magic, magicBytes, sizeof(magicBytes));
+    header.version = CheckpointHeader::currentVersion;
+    header.headerBytes = sizeof(CheckpointHeader);
+    header.byteOrder = byteOrderMark;
+    header.particleBytes = sizeof(BasicParticle<Real>);
+    header.scalarBytes = sizeof(Real);
+    header.compact = compactBuild;
+    header.particleCount = particles.size();
+    header.particleOffset = alignUp(sizeof(CheckpointHeader), particleAlignment);
+    header.rngOffset = header.particleOffset + particles.size() * sizeof(BasicParticle<Real>);
+    header.rngBytes = rngState.size();
+    header.time = time;
+    header.step = step;
+    header.radius = parameters.radius;
+    header.mass = parameters.mass;
+    header.damping = parameters.damping;
+    header.targetDensity = parameters.targetDensity;
+    header.pressureMultiplier = parameters.pressureMultiplier;
+    header.periodic = (parameters.periodicX ? 1u : 0u) | (parameters.periodicY ? 2u : 0u);
+
+    const std::string temporary = std::string(filename) + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out)
+            throw std::runtime_error("Could not write checkpoint: " + temporary);
+        const char padding[particleAlignment] = {};
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(padding, header.particleOffset - sizeof(header));
+        out.write(reinterpret_cast<const char *>(particles.data()), particles.size() * sizeof(BasicParticle<Real>));
+        out.write(rngState.data(), rngState.size());
+        if (!out.flush())
+            throw std::runtime_error("Could not write checkpoint: " + temporary);
+    }
+
+    // rename cannot replace an existing file everywhere, fall back to remove + rename
+    if (std::rename(temporary.c_str(), filename) != 0 && (std::remove(filename) != 0 || std::rename(temporary.c_str(), filename) != 0))
+        throw std::runtime_error(std::string("Could not replace checkpoint: ") + filename);
+}
+
+template void writeCheckpoint(const char *, const std::vector<Particle> &, const SimulationParameters &, double, uint64_t, const std::mt19937 &);
+template void writeCheckpoint(const char *, const std::vector<ParticleD> &, const SimulationParameters &, double, uint64_t, const std::mt19937 &);
+
+MappedCheckpoint::MappedCheckpoint(const char *filename)
+    : bytes(nullptr), byteCount(0), mapped(false), header(), particleData(nullptr)
+{
+#ifdef _WIN32
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+        throw std::runtime_error(std::string("Could not open checkpoint: ") + filename);
+    std::vector<char> contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    byteCount = contents.size();
+    unsigned char *buffer = new unsigned char[byteCount > 0 ? byteCount : 1];
+    std::memcpy(buffer, contents.data(), byteCount);
+    bytes = buffer;
+#else
+    int file = open(filename, O_RDONLY);
+    if (file < 0)
+        throw std::runtime_error(std::string("Could not open checkpoint: ") + filename);
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(CheckpointHeader)))
+    {
+        close(file);
+        throw std::runtime_error(std::string("Truncated checkpoint: ") + filename);
+    }
+    byteCount = static_cast<size_t>(info.st_size);
+    // private mapping: pages are read lazily and never written back
+    void *mapping = mmap(nullptr, byteCount, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error(std::string("Could not map checkpoint: ") + filename);
+    bytes = static_cast<const unsigned char *>(mapping);
+    mapped = true;
+#endif
+
+    // from here on the destructor is not run if we throw, so release by hand
+    auto fail = [&](const std::string &message)
+    {
+        release();
+        throw std::runtime_error(message + ": " + filename);
+    };
+
+    if (byteCount < sizeof(CheckpointHeader))
+        fail("Truncated checkpoint");
+    std::memcpy(&header, bytes, sizeof(CheckpointHeader));
+    if (std::memcmp(header.magic, magicBytes, sizeof(magicBytes)) != 0)
+        fail("Not a checkpoint");
+    if (header.byteOrder != byteOrderMark)
+        fail("Checkpoint has a different byte order");
+    if (header.version > CheckpointHeader::currentVersion || header.headerBytes < sizeof(CheckpointHeader))
+        fail("Unsupported checkpoint version " + std::to_string(header.version));
+    if (header.particleOffset + header.particleCount * header.particleBytes > byteCount || header.rngOffset + header.rngBytes > byteCount)
+        fail("Truncated checkpoint");
+
+    const unsigned char *first = bytes + header.particleOffset;
+    if (reinterpret_cast<uintptr_t>(first) % alignof(std::max_align_t) == 0)
+        particleData = first;
+    else
+    {
+        const size_t particleBytes = static_cast<size_t>(header.particleCount * header.particleBytes);
+        copy.resize((particleBytes + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t));
+        std::memcpy(copy.data(), first, particleBytes);
+        particleData = copy.data();
+    }
+}
+
+MappedCheckpoint::~MappedCheckpoint()
+{
+    release();
+}
+
+void MappedCheckpoint::release()
+{
+#ifdef _WIN32
+    delete[] bytes;
+#else
+    if (mapped && bytes != nullptr)
+        munmap(const_cast<unsigned char *>(bytes), byteCount);
+#endif
+    bytes = nullptr;
+}
+
+template <typename Real>
+void MappedCheckpoint::checkLayout() const
+{
+    if (header.scalarBytes != sizeof(Real) || header.particleBytes != sizeof(BasicParticle<Real>) || header.compact != compactBuild)
+        throw std::runtime_error("Checkpoint particle layout (" + std::to_string(header.scalarBytes) + " byte scalars, " +
+                                 std::to_string(header.particleBytes) + " byte particles" + (header.compact ? ", compact" : "") +
+                                 ") does not match this build");
+}
+
+template void MappedCheckpoint::checkLayout<float>() const;
+template void MappedCheckpoint::checkLayout<double>() const;
+
+SimulationParameters MappedCheckpoint::getParameters() const
+{
+    return SimulationParameters{header.radius, header.mass, header.damping, header.targetDensity, header.pressureMultiplier,
+                                (header.periodic & 1u) != 0, (header.periodic & 2u) != 0};
+}
+
+std::mt19937 MappedCheckpoint::getRng() const
+{
+    std::istringstream text(std::string(reinterpret_cast<const char *>(bytes + header.rngOffset), header.rngBytes));
+    std::mt19937 rng;
+    if (!(text >> rng))
+        throw std::runtime_error("Corrupt RNG state in checkpoint");
+    return rng;
+}
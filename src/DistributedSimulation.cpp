@@ -0,0 +1,217 @@
+#include "DistributedSimulation.h"
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+namespace
+{
+    static_assert(std::is_trivially_copyable<Particle>::value, "particles are sent as raw bytes");
+
+    constexpr int binsPerRank = 64;
+}
+
+DistributedSimulation::DistributedSimulation(MPI_Comm comm, std::unique_ptr<SimulationBase> solver)
+    : comm(comm), solver(std::move(solver)), rebalanceThreshold(1.1f), ghostCount(0), rebalanceCount(0)
+{
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &rankCount);
+    MPI_Type_contiguous(static_cast<int>(sizeof(Particle)), MPI_BYTE, &particleType);
+    MPI_Type_commit(&particleType);
+
+    const BoundarySettings &boundary = this->solver->getBoundary();
+    cuts.resize(rankCount + 1);
+    for (int r = 0; r <= rankCount; ++r)
+        cuts[r] = boundary.domainMin.x + (boundary.domainMax.x - boundary.domainMin.x) * r / rankCount;
+    cuts.front() = -std::numeric_limits<float>::infinity();
+    cuts.back() = std::numeric_limits<float>::infinity();
+
+    sendCounts.resize(rankCount);
+    sendOffsets.resize(rankCount);
+    receiveCounts.resize(rankCount);
+    receiveOffsets.resize(rankCount);
+}
+
+DistributedSimulation::~DistributedSimulation()
+{
+    MPI_Type_free(&particleType);
+}
+
+int DistributedSimulation::ownerOf(float x) const
+{
+    return static_cast<int>(std::upper_bound(cuts.begin() + 1, cuts.end() - 1, x) - (cuts.begin() + 1));
+}
+
+float DistributedSimulation::slabDistance(float x, int r) const
+{
+    auto distance = [&](float px)
+    { return std::max({cuts[r] - px, px - cuts[r + 1], 0.0f}); };
+
+    const BoundarySettings &boundary = solver->getBoundary();
+    float d = distance(x);
+    if (boundary.periodicX)
+    {
+        // ghosts keep their coordinates, the wrapped grid finds them across the seam
+        const float extent = boundary.domainMax.x - boundary.domainMin.x;
+        d = std::min({d, distance(x - extent), distance(x + extent)});
+    }
+    return d;
+}
+
+void DistributedSimulation::exchange(std::vector<Particle> &particles)
+{
+    // counting sort of the outgoing particles by destination
+    std::fill(sendCounts.begin(), sendCounts.end(), 0);
+    for (const auto &entry : outgoing)
+        ++sendCounts[entry.first];
+    int offset = 0;
+    for (int r = 0; r < rankCount; ++r)
+    {
+        sendOffsets[r] = offset;
+        offset += sendCounts[r];
+    }
+    sendBuffer.assign(outgoing.size(), Particle(glm::vec2(0.0f), glm::vec2(0.0f)));
+    std::vector<int> &cursor = receiveOffsets; // free until the counts come back
+    std::copy(sendOffsets.begin(), sendOffsets.end(), cursor.begin());
+    for (const auto &entry : outgoing)
+        sendBuffer[cursor[entry.first]++] = particles[entry.second];
+
+    MPI_Alltoall(sendCounts.data(), 1, MPI_INT, receiveCounts.data(), 1, MPI_INT, comm);
+
+    // counted in particles, so byte counts never have to fit an int
+    const size_t before = particles.size();
+    int received = 0;
+    for (int r = 0; r < rankCount; ++r)
+    {
+        receiveOffsets[r] = received;
+        received += receiveCounts[r];
+    }
+    particles.resize(before + received, Particle(glm::vec2(0.0f), glm::vec2(0.0f)));
+    MPI_Alltoallv(sendBuffer.data(), sendCounts.data(), sendOffsets.data(), particleType,
+                  particles.data() + before, receiveCounts.data(), receiveOffsets.data(), particleType, comm);
+}
+
+void DistributedSimulation::migrate(std::vector<Particle> &particles)
+{
+    outgoing.clear();
+    for (uint32_t i = 0; i < particles.size(); ++i)
+    {
+        int owner = ownerOf(particles[i].position.x);
+        if (owner != rank)
+            outgoing.emplace_back(owner, i);
+    }
+    const size_t before = particles.size();
+    exchange(particles);
+
+    // close the gaps the leavers left, arrivals were appended after the old particles
+    size_t write = 0;
+    size_t next = 0;
+    for (size_t i = 0; i < particles.size(); ++i)
+    {
+        if (i < before && next < outgoing.size() && outgoing[next].second == i)
+        {
+            ++next;
+            continue;
+        }
+        particles[write++] = particles[i];
+    }
+    particles.erase(particles.begin() + write, particles.end());
+}
+
+void DistributedSimulation::appendGhosts(std::vector<Particle> &particles, float width)
+{
+    outgoing.clear();
+    for (uint32_t i = 0; i < particles.size(); ++i)
+    {
+        // slabs thinner than the halo put more than the next rank within reach
+        const float x = particles[i].position.x;
+        for (int r = 0; r < rankCount; ++r)
+        {
+            if (r != rank && slabDistance(x, r) < width)
+                outgoing.emplace_back(r, i);
+        }
+    }
+    const size_t owned = particles.size();
+    exchange(particles);
+    ghostCount = particles.size() - owned;
+}
+
+void DistributedSimulation::rebalance(const std::vector<Particle> &particles)
+{
+    uint64_t local = particles.size();
+    uint64_t total = 0;
+    uint64_t busiest = 0;
+    MPI_Allreduce(&local, &total, 1, MPI_UINT64_T, MPI_SUM, comm);
+    MPI_Allreduce(&local, &busiest, 1, MPI_UINT64_T, MPI_MAX, comm);
+    if (total == 0 || static_cast<float>(busiest) <= rebalanceThreshold * total / rankCount)
+        return;
+
+    // global x range, then a shared histogram to place the cuts at equal counts
+    float range[2] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    for (const auto &particle : particles)
+    {
+        range[0] = std::min(range[0], particle.position.x);
+        range[1] = std::min(range[1], -particle.position.x);
+    }
+    MPI_Allreduce(MPI_IN_PLACE, range, 2, MPI_FLOAT, MPI_MIN, comm);
+    const float low = range[0];
+    const float width = std::max(-range[1] - low, 1e-6f);
+
+    const int bins = binsPerRank * rankCount;
+    histogram.assign(bins, 0);
+    for (const auto &particle : particles)
+        ++histogram[std::min(bins - 1, static_cast<int>((particle.position.x - low) / width * bins))];
+    MPI_Allreduce(MPI_IN_PLACE, histogram.data(), bins, MPI_UINT32_T, MPI_SUM, comm);
+
+    uint64_t running = 0;
+    int r = 1;
+    for (int b = 0; b < bins && r < rankCount; ++b)
+    {
+        running += histogram[b];
+        while (r < rankCount && running * rankCount >= total * r)
+            cuts[r++] = low + width * (b + 1) / bins;
+    }
+    for (; r < rankCount; ++r)
+        cuts[r] = low + width;
+    ++rebalanceCount;
+}
+
+void DistributedSimulation::distribute(std::vector<Particle> &particles)
+{
+    particles.erase(std::remove_if(particles.begin(), particles.end(), [&](const Particle &particle)
+                                   { return ownerOf(particle.position.x) != rank; }),
+                    particles.end());
+}
+
+void DistributedSimulation::step(std::vector<Particle> &particles, float deltaTime, const std::vector<InteractionField> &fields)
+{
+    rebalance(particles);
+    migrate(particles);
+
+    // a neighbor's predicted position is at most radius + both predictions away, and a ghost's
+    // own density needs the same reach again. Predictions move at most maxParticleSpeed, the bound
+    // the interaction field queries pad by.
+    const float dt = std::clamp(deltaTime, 0.001f, 0.033f);
+    const float reach = solver->getRadius() + 2.0f * maxParticleSpeed * dt;
+    const size_t owned = particles.size();
+    appendGhosts(particles, 2.0f * reach);
+
+    solver->updateParticles(particles, deltaTime, fields);
+    particles.erase(particles.begin() + owned, particles.end());
+}
+
+void DistributedSimulation::gather(const std::vector<Particle> &particles, std::vector<Particle> &all, int root) const
+{
+    int local = static_cast<int>(particles.size());
+    std::vector<int> counts(rankCount), offsets(rankCount);
+    MPI_Gather(&local, 1, MPI_INT, counts.data(), 1, MPI_INT, root, comm);
+
+    int total = 0;
+    for (int r = 0; r < rankCount; ++r)
+    {
+        offsets[r] = total;
+        total += counts[r];
+    }
+    all.assign(rank == root ? total : 0, Particle(glm::vec2(0.0f), glm::vec2(0.0f)));
+    MPI_Gatherv(particles.data(), local, particleType, all.data(), counts.data(), offsets.data(), particleType, root, comm);
+}
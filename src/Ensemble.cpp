@@ -0,0 +1,247 @@
+#include "Ensemble.h"
+#include "Simulation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace
+{
+    // how often a run checks for a blow-up
+    constexpr int finiteCheckInterval = 50;
+
+    struct SweepAxis
+    {
+        std::string name;
+        std::vector<double> values;
+    };
+
+    void assign(RunParameters &run, const std::string &name, double value)
+    {
+        if (name == "particles")
+            run.particles = static_cast<int>(value);
+        else if (name == "pressureMultiplier")
+            run.pressureMultiplier = static_cast<float>(value);
+        else if (name == "targetDensity")
+            run.targetDensity = static_cast<float>(value);
+        else if (name == "damping")
+            run.damping = static_cast<float>(value);
+        else if (name == "radius")
+            run.radius = static_cast<float>(value);
+        else if (name == "mass")
+            run.mass = static_cast<float>(value);
+        else if (name == "steps")
+            run.steps = static_cast<int>(value);
+        else if (name == "deltaTime")
+            run.deltaTime = static_cast<float>(value);
+    }
+
+    // Accepted values per name, checked when the sweep is read so no run starts with a nonsensical one
+    struct ParameterRange
+    {
+        const char *name;
+        double minimum;
+        bool exclusive; // minimum itself is not allowed, e.g. a zero radius or time step
+        bool integer;
+    };
+
+    const ParameterRange parameterRanges[] = {
+        {"particles", 1.0, false, true},
+        {"pressureMultiplier", 0.0, false, false},
+        {"targetDensity", 0.0, true, false},
+        {"damping", 0.0, false, false},
+        {"radius", 0.0, true, false},
+        {"mass", 0.0, true, false},
+        {"steps", 1.0, false, true},
+        {"deltaTime", 0.0, true, false},
+        {"repeats", 1.0, false, true}};
+
+    const ParameterRange *findParameter(const std::string &name)
+    {
+        for (const ParameterRange &range : parameterRanges)
+        {
+            if (name == range.name)
+                return &range;
+        }
+        return nullptr;
+    }
+
+    // Empty if value is allowed, otherwise what is expected
+    std::string checkValue(const ParameterRange &range, double value)
+    {
+        std::ostringstream expected;
+        if (range.integer)
+            expected << "an integer of at least " << range.minimum;
+        else if (range.exclusive)
+            expected << "a positive number";
+        else
+            expected << "a number of at least " << range.minimum;
+        const bool ok = std::isfinite(value) && (range.exclusive ? value > range.minimum : value >= range.minimum) &&
+                        (!range.integer || (value == std::floor(value) && value <= 2147483647.0));
+        return ok ? std::string() : expected.str();
+    }
+}
+
+std::vector<RunParameters> loadSweep(const char *filename)
+{
+    std::ifstream in(filename);
+    if (!in)
+        throw std::runtime_error(std::string("Could not open sweep file: ") + filename);
+
+    std::vector<SweepAxis> axes;
+    int repeats = 1;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line))
+    {
+        ++lineNumber;
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        SweepAxis axis;
+        if (!(tokens >> axis.name))
+            continue;
+        const std::string where = std::string(filename) + ":" + std::to_string(lineNumber) + ": ";
+        const ParameterRange *range = findParameter(axis.name);
+        if (range == nullptr)
+            throw std::runtime_error(where + "unknown parameter \"" + axis.name + "\"");
+
+        double value;
+        while (tokens >> value)
+        {
+            const std::string expected = checkValue(*range, value);
+            if (!expected.empty())
+            {
+                std::ostringstream message;
+                message << where << axis.name << " must be " << expected << ", got " << value;
+                throw std::runtime_error(message.str());
+            }
+            axis.values.push_back(value);
+        }
+        if (axis.values.empty() || !tokens.eof())
+            throw std::runtime_error(where + "expected \"" + axis.name + " value [value ...]\"");
+
+        if (axis.name == "repeats")
+            repeats = static_cast<int>(axis.values.back());
+        else
+            axes.push_back(std::move(axis));
+    }
+
+    // odometer over the axes, the last listed one varies fastest
+    std::vector<RunParameters> runs;
+    std::vector<size_t> digit(axes.size(), 0);
+    for (;;)
+    {
+        RunParameters run;
+        for (size_t a = 0; a < axes.size(); ++a)
+            assign(run, axes[a].name, axes[a].values[digit[a]]);
+        for (int r = 1; r <= repeats; ++r)
+        {
+            run.seed = static_cast<unsigned>(r);
+            runs.push_back(run);
+        }
+
+        size_t a = axes.size();
+        while (a > 0 && ++digit[a - 1] == axes[a - 1].values.size())
+            digit[--a] = 0;
+        if (a == 0)
+            break;
+    }
+    return runs;
+}
+
+RunMetrics runSimulation(const RunParameters &parameters)
+{
+    std::mt19937 rng(parameters.seed);
+    std::vector<Particle> particles = generateParticles(parameters.particles, -0.5f, 0.5f, -0.5f, 0.5f, rng);
+    Simulation simulation(parameters.radius, parameters.mass, parameters.damping, parameters.targetDensity, parameters.pressureMultiplier);
+    const std::vector<InteractionField> fields;
+
+    RunMetrics metrics;
+    auto start = std::chrono::steady_clock::now();
+    int step = 0;
+    while (step < parameters.steps && metrics.finite)
+    {
+        simulation.updateParticles(particles, parameters.deltaTime, fields);
+        ++step;
+        if (step % finiteCheckInterval == 0)
+        {
+            for (const auto &particle : particles)
+                metrics.finite &= std::isfinite(particle.position.x) && std::isfinite(particle.position.y);
+        }
+    }
+    metrics.msPerStep = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / std::max(step, 1);
+
+    if (particles.empty())
+        return metrics;
+    double squaredError = 0.0;
+    for (const auto &particle : particles)
+    {
+        const double speed = glm::length(glm::dvec2(particle.velocity));
+        metrics.kineticEnergy += 0.5 * parameters.mass * speed * speed;
+        metrics.meanDensity += particle.density;
+        const double error = (particle.density - parameters.targetDensity) / parameters.targetDensity;
+        squaredError += error * error;
+        metrics.maxSpeed = std::max(metrics.maxSpeed, speed);
+        metrics.meanHeight += particle.position.y;
+        metrics.finite &= std::isfinite(particle.position.x) && std::isfinite(particle.position.y);
+    }
+    const double count = static_cast<double>(particles.size());
+    metrics.kineticEnergy /= count;
+    metrics.meanDensity /= count;
+    metrics.densityError = std::sqrt(squaredError / count);
+    metrics.meanHeight /= count;
+    return metrics;
+}
+
+void runEnsemble(const std::vector<RunParameters> &runs, unsigned threads,
+                 const std::function<void(size_t, const RunMetrics &)> &done)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, runs.size()));
+
+    // longest first, so a big run does not start last and leave the other cores idle
+    std::vector<size_t> order(runs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                     { return double(runs[a].particles) * runs[a].steps > double(runs[b].particles) * runs[b].steps; });
+
+    std::atomic<size_t> next(0);
+    std::mutex reportMutex;
+    auto worker = [&]()
+    {
+        for (size_t k = next.fetch_add(1); k < order.size(); k = next.fetch_add(1))
+        {
+            // a run that throws (e.g. out of memory) is reported as failed, the others carry on
+            RunMetrics metrics;
+            try
+            {
+                metrics = runSimulation(runs[order[k]]);
+            }
+            catch (const std::exception &)
+            {
+                metrics = RunMetrics();
+                metrics.failed = true;
+                metrics.finite = false;
+            }
+            std::lock_guard<std::mutex> lock(reportMutex);
+            done(order[k], metrics);
+        }
+    };
+
+    // the calling thread is one of the workers
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t)
+        pool.emplace_back(worker);
+    worker();
+    for (auto &thread : pool)
+        thread.join();
+}
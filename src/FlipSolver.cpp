@@ -0,0 +1,472 @@
+#include "FlipSolver.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+    // Bilinear stencil on one staggered velocity component, samples at minCorner + (i + offset) * cellSize
+    struct Stencil
+    {
+        int index[4];
+        float weight[4];
+        glm::vec2 gradient[4]; // d weight / d position
+        glm::vec2 node[4];     // world position of each sample
+    };
+
+    Stencil makeStencil(const glm::vec2 &pos, const glm::vec2 &minCorner, float cellSize, const glm::vec2 &offset, int width, int height)
+    {
+        glm::vec2 local = (pos - minCorner) / cellSize - offset;
+        int i = std::clamp(static_cast<int>(std::floor(local.x)), 0, width - 2);
+        int j = std::clamp(static_cast<int>(std::floor(local.y)), 0, height - 2);
+        float tx = std::clamp(local.x - i, 0.0f, 1.0f);
+        float ty = std::clamp(local.y - j, 0.0f, 1.0f);
+
+        Stencil s;
+        s.index[0] = j * width + i;
+        s.index[1] = j * width + i + 1;
+        s.index[2] = (j + 1) * width + i;
+        s.index[3] = (j + 1) * width + i + 1;
+        s.weight[0] = (1.0f - tx) * (1.0f - ty);
+        s.weight[1] = tx * (1.0f - ty);
+        s.weight[2] = (1.0f - tx) * ty;
+        s.weight[3] = tx * ty;
+        s.gradient[0] = glm::vec2(-(1.0f - ty), -(1.0f - tx)) / cellSize;
+        s.gradient[1] = glm::vec2(1.0f - ty, -tx) / cellSize;
+        s.gradient[2] = glm::vec2(-ty, 1.0f - tx) / cellSize;
+        s.gradient[3] = glm::vec2(ty, tx) / cellSize;
+        for (int k = 0; k < 4; ++k)
+            s.node[k] = minCorner + (glm::vec2(i + (k & 1), j + (k >> 1)) + offset) * cellSize;
+        return s;
+    }
+
+    // Fills faces without particle support from valid neighbors, a few layers out from the fluid,
+    // so particles near the free surface do not sample zero velocity. valid is 1 for known faces.
+    void extrapolate(std::vector<float> &field, std::vector<float> &valid, int width, int height, int layers)
+    {
+        for (int layer = 0; layer < layers; ++layer)
+        {
+            const float marker = 2.0f + layer; // faces filled this layer do not feed the same layer
+            for (int j = 0; j < height; ++j)
+            {
+                for (int i = 0; i < width; ++i)
+                {
+                    int index = j * width + i;
+                    if (valid[index] != 0.0f)
+                        continue;
+                    float sum = 0.0f;
+                    int count = 0;
+                    const int neighbors[4][2] = {{i - 1, j}, {i + 1, j}, {i, j - 1}, {i, j + 1}};
+                    for (const auto &n : neighbors)
+                    {
+                        if (n[0] < 0 || n[1] < 0 || n[0] >= width || n[1] >= height)
+                            continue;
+                        float state = valid[n[1] * width + n[0]];
+                        if (state != 0.0f && state != marker)
+                        {
+                            sum += field[n[1] * width + n[0]];
+                            ++count;
+                        }
+                    }
+                    if (count > 0)
+                    {
+                        field[index] = sum / count;
+                        valid[index] = marker;
+                    }
+                }
+            }
+        }
+    }
+
+    // forget extrapolated faces so they can be refilled from updated velocities
+    void clearExtrapolated(std::vector<float> &valid)
+    {
+        for (auto &state : valid)
+        {
+            if (state > 1.0f)
+                state = 0.0f;
+        }
+    }
+}
+
+static int cellCount(float extent, float cellSize)
+{
+    return std::max(3, static_cast<int>(std::ceil(extent / cellSize)));
+}
+
+FlipSolver::FlipSolver(glm::vec2 minCorner, glm::vec2 maxCorner, float cellSize, ThreadPool *pool)
+    : minCorner(minCorner), maxCorner(maxCorner), cellSize(cellSize),
+      nx(cellCount(maxCorner.x - minCorner.x, cellSize)), ny(cellCount(maxCorner.y - minCorner.y, cellSize)),
+      flipRatio(0.95f), apic(true), gravity(0.0f, -9.81f), boundaryField(nullptr), pool(pool),
+      pressureSolver(nx, ny, pool)
+{
+    u.assign((nx + 1) * ny, 0.0f);
+    uWeight.assign(u.size(), 0.0f);
+    uPrevious.assign(u.size(), 0.0f);
+    v.assign(nx * (ny + 1), 0.0f);
+    vWeight.assign(v.size(), 0.0f);
+    vPrevious.assign(v.size(), 0.0f);
+    pressure.assign(nx * ny, 0.0f);
+    rhs.assign(nx * ny, 0.0f);
+    cellType.assign(nx * ny, CellType::Air);
+    pressureStats = PoissonStats{0, 0.0f, 0.0f, 0.0};
+    bandCount = (ny + bandRows - 1) / bandRows;
+    bandStart.assign(bandCount + 1, 0);
+}
+
+void FlipSolver::setFlipRatio(float ratio)
+{
+    flipRatio = std::clamp(ratio, 0.0f, 1.0f);
+}
+
+void FlipSolver::setAPIC(bool enabled)
+{
+    apic = enabled;
+}
+
+void FlipSolver::setPressureTolerance(float relative, int maxCycles)
+{
+    pressureSolver.setTolerance(relative);
+    pressureSolver.setMaxCycles(maxCycles);
+}
+
+void FlipSolver::setBoundaryField(const SignedDistanceField *field)
+{
+    boundaryField = field;
+}
+
+bool FlipSolver::isSolid(int i, int j) const
+{
+    return i < 0 || j < 0 || i >= nx || j >= ny || cellType[j * nx + i] == CellType::Solid;
+}
+
+void FlipSolver::forRange(size_t count, const std::function<void(size_t, size_t)> &body)
+{
+    if (pool == nullptr)
+    {
+        body(0, count);
+        return;
+    }
+    pool->parallelFor(0, count, body);
+}
+
+// clamped like the stencils, so every face a particle splats into lies within one row of this cell row
+int FlipSolver::cellRow(const glm::vec2 &position) const
+{
+    float row = (position.y - minCorner.y) / cellSize;
+    return row > 0.0f ? static_cast<int>(std::min(row, static_cast<float>(ny - 1))) : 0;
+}
+
+void FlipSolver::binParticles(const std::vector<Particle> &particles)
+{
+    // counting sort in fixed blocks of particles, so the order does not depend on the thread count
+    const size_t count = particles.size();
+    const size_t blocks = pool ? pool->size() : 1;
+    particleBand.resize(count);
+    bandOrder.resize(count);
+    blockCounts.assign(blocks * bandCount, 0);
+
+    auto forBlocks = [&](const std::function<void(size_t, size_t, size_t)> &body)
+    {
+        forRange(blocks, [&](size_t begin, size_t end)
+                 {
+            for (size_t block = begin; block < end; ++block)
+                body(block, count * block / blocks, count * (block + 1) / blocks); });
+    };
+
+    forBlocks([&](size_t block, size_t begin, size_t end)
+              {
+        uint32_t *histogram = &blockCounts[block * bandCount];
+        for (size_t p = begin; p < end; ++p)
+        {
+            uint32_t band = static_cast<uint32_t>(cellRow(particles[p].position) / bandRows);
+            particleBand[p] = band;
+            ++histogram[band];
+        } });
+
+    // band major offsets keep each band's particles in index order
+    uint32_t offset = 0;
+    for (int band = 0; band < bandCount; ++band)
+    {
+        bandStart[band] = offset;
+        for (size_t block = 0; block < blocks; ++block)
+        {
+            uint32_t &slot = blockCounts[block * bandCount + band];
+            uint32_t bandParticles = slot;
+            slot = offset;
+            offset += bandParticles;
+        }
+    }
+    bandStart[bandCount] = offset;
+
+    forBlocks([&](size_t block, size_t begin, size_t end)
+              {
+        uint32_t *cursor = &blockCounts[block * bandCount];
+        for (size_t p = begin; p < end; ++p)
+            bandOrder[cursor[particleBand[p]]++] = static_cast<uint32_t>(p); });
+}
+
+void FlipSolver::step(std::vector<Particle> &particles, float deltaTime)
+{
+    if (affineX.size() != particles.size())
+    {
+        affineX.assign(particles.size(), glm::vec2(0.0f));
+        affineY.assign(particles.size(), glm::vec2(0.0f));
+    }
+
+    binParticles(particles);
+    classifyCells(particles);
+    particlesToGrid(particles);
+    extrapolate(u, uWeight, nx + 1, ny, 2);
+    extrapolate(v, vWeight, nx, ny + 1, 2);
+    uPrevious = u;
+    vPrevious = v;
+    applyForces(deltaTime);
+    enforceSolidFaces();
+    project(deltaTime);
+    clearExtrapolated(uWeight);
+    clearExtrapolated(vWeight);
+    extrapolate(u, uWeight, nx + 1, ny, 2);
+    extrapolate(v, vWeight, nx, ny + 1, 2);
+    gridToParticles(particles);
+    advect(particles, deltaTime);
+}
+
+void FlipSolver::classifyCells(const std::vector<Particle> &particles)
+{
+    // one cell thick wall around the domain, plus whatever the static geometry covers
+    forRange(ny, [&](size_t begin, size_t end)
+             {
+        for (int j = static_cast<int>(begin); j < static_cast<int>(end); ++j)
+        {
+            for (int i = 0; i < nx; ++i)
+            {
+                bool solid = i == 0 || j == 0 || i == nx - 1 || j == ny - 1;
+                if (!solid && boundaryField)
+                {
+                    float distance;
+                    glm::vec2 normal;
+                    boundaryField->sample(minCorner + (glm::vec2(i, j) + 0.5f) * cellSize, distance, normal);
+                    solid = distance < 0.0f;
+                }
+                cellType[j * nx + i] = solid ? CellType::Solid : CellType::Air;
+            }
+        } });
+
+    // a particle marks at most its own cell, which lies in its band, so bands can run concurrently
+    forRange(bandCount, [&](size_t begin, size_t end)
+             {
+        for (uint32_t slot = bandStart[begin]; slot < bandStart[end]; ++slot)
+        {
+            const Particle &particle = particles[bandOrder[slot]];
+            int i = static_cast<int>(std::floor((particle.position.x - minCorner.x) / cellSize));
+            int j = static_cast<int>(std::floor((particle.position.y - minCorner.y) / cellSize));
+            if (i >= 0 && j >= 0 && i < nx && j < ny && cellType[j * nx + i] == CellType::Air)
+                cellType[j * nx + i] = CellType::Fluid;
+        } });
+}
+
+void FlipSolver::particlesToGrid(const std::vector<Particle> &particles)
+{
+    std::fill(u.begin(), u.end(), 0.0f);
+    std::fill(v.begin(), v.end(), 0.0f);
+    std::fill(uWeight.begin(), uWeight.end(), 0.0f);
+    std::fill(vWeight.begin(), vWeight.end(), 0.0f);
+
+    auto splat = [&](uint32_t p)
+    {
+        const Particle &particle = particles[p];
+        // mass follows the adaptive size so split particles do not outweigh their parents
+        const float mass = particle.sizeScale * particle.sizeScale;
+
+        Stencil su = makeStencil(particle.position, minCorner, cellSize, glm::vec2(0.0f, 0.5f), nx + 1, ny);
+        Stencil sv = makeStencil(particle.position, minCorner, cellSize, glm::vec2(0.5f, 0.0f), nx, ny + 1);
+        for (int k = 0; k < 4; ++k)
+        {
+            // APIC: each face sees the particle velocity field extended affinely to the face position
+            float velocityU = particle.velocity.x;
+            float velocityV = particle.velocity.y;
+            if (apic)
+            {
+                velocityU += glm::dot(affineX[p], su.node[k] - particle.position);
+                velocityV += glm::dot(affineY[p], sv.node[k] - particle.position);
+            }
+            u[su.index[k]] += mass * su.weight[k] * velocityU;
+            uWeight[su.index[k]] += mass * su.weight[k];
+            v[sv.index[k]] += mass * sv.weight[k] * velocityV;
+            vWeight[sv.index[k]] += mass * sv.weight[k];
+        }
+    };
+
+    // band b writes face rows [b * bandRows - 1, (b + 1) * bandRows], so bands of one colour are disjoint
+    for (int color = 0; color < 2; ++color)
+    {
+        forRange((bandCount + 1 - color) / 2, [&](size_t begin, size_t end)
+                 {
+            for (size_t k = begin; k < end; ++k)
+            {
+                const size_t band = 2 * k + color;
+                for (uint32_t slot = bandStart[band]; slot < bandStart[band + 1]; ++slot)
+                    splat(bandOrder[slot]);
+            } });
+    }
+
+    // normalize, then turn the weights into a valid mask for extrapolation
+    forRange(u.size(), [&](size_t begin, size_t end)
+             {
+        for (size_t f = begin; f < end; ++f)
+        {
+            u[f] = uWeight[f] > 0.0f ? u[f] / uWeight[f] : 0.0f;
+            uWeight[f] = uWeight[f] > 0.0f ? 1.0f : 0.0f;
+        } });
+    forRange(v.size(), [&](size_t begin, size_t end)
+             {
+        for (size_t f = begin; f < end; ++f)
+        {
+            v[f] = vWeight[f] > 0.0f ? v[f] / vWeight[f] : 0.0f;
+            vWeight[f] = vWeight[f] > 0.0f ? 1.0f : 0.0f;
+        } });
+}
+
+void FlipSolver::applyForces(float deltaTime)
+{
+    for (auto &velocity : u)
+        velocity += gravity.x * deltaTime;
+    for (auto &velocity : v)
+        velocity += gravity.y * deltaTime;
+}
+
+void FlipSolver::enforceSolidFaces()
+{
+    for (int j = 0; j < ny; ++j)
+    {
+        for (int i = 0; i <= nx; ++i)
+        {
+            if (isSolid(i - 1, j) || isSolid(i, j))
+                u[j * (nx + 1) + i] = 0.0f;
+        }
+    }
+    for (int j = 0; j <= ny; ++j)
+    {
+        for (int i = 0; i < nx; ++i)
+        {
+            if (isSolid(i, j - 1) || isSolid(i, j))
+                v[j * nx + i] = 0.0f;
+        }
+    }
+}
+
+void FlipSolver::project(float deltaTime)
+{
+    // count * p_i - sum(p_j) = -divergence * h^2 / dt, which makes the corrected faces divergence free
+    const float rhsScale = cellSize * cellSize / deltaTime;
+    for (int j = 0; j < ny; ++j)
+    {
+        for (int i = 0; i < nx; ++i)
+        {
+            int cell = j * nx + i;
+            rhs[cell] = 0.0f;
+            if (cellType[cell] != CellType::Fluid)
+                continue;
+            float divergence = (u[j * (nx + 1) + i + 1] - u[j * (nx + 1) + i] + v[(j + 1) * nx + i] - v[j * nx + i]) / cellSize;
+            rhs[cell] = -divergence * rhsScale;
+        }
+    }
+
+    // last step's pressure is a good initial guess
+    pressureStats = pressureSolver.solve(cellType, rhs, pressure);
+
+    // subtract the pressure gradient on faces touching fluid, air cells hold zero pressure
+    const float scale = deltaTime / cellSize;
+    for (int j = 0; j < ny; ++j)
+    {
+        for (int i = 1; i < nx; ++i)
+        {
+            if (isSolid(i - 1, j) || isSolid(i, j))
+                continue;
+            if (cellType[j * nx + i - 1] != CellType::Fluid && cellType[j * nx + i] != CellType::Fluid)
+                continue;
+            int face = j * (nx + 1) + i;
+            u[face] -= scale * (pressure[j * nx + i] - pressure[j * nx + i - 1]);
+            uWeight[face] = 1.0f;
+        }
+    }
+    for (int j = 1; j < ny; ++j)
+    {
+        for (int i = 0; i < nx; ++i)
+        {
+            if (isSolid(i, j - 1) || isSolid(i, j))
+                continue;
+            if (cellType[(j - 1) * nx + i] != CellType::Fluid && cellType[j * nx + i] != CellType::Fluid)
+                continue;
+            int face = j * nx + i;
+            v[face] -= scale * (pressure[j * nx + i] - pressure[(j - 1) * nx + i]);
+            vWeight[face] = 1.0f;
+        }
+    }
+}
+
+void FlipSolver::gridToParticles(std::vector<Particle> &particles)
+{
+    // each particle only reads the grid and writes itself
+    forRange(particles.size(), [&](size_t begin, size_t end)
+             {
+        for (size_t p = begin; p < end; ++p)
+        {
+            Particle &particle = particles[p];
+            Stencil su = makeStencil(particle.position, minCorner, cellSize, glm::vec2(0.0f, 0.5f), nx + 1, ny);
+            Stencil sv = makeStencil(particle.position, minCorner, cellSize, glm::vec2(0.5f, 0.0f), nx, ny + 1);
+
+            glm::vec2 pic(0.0f);
+            glm::vec2 delta(0.0f);
+            glm::vec2 cx(0.0f), cy(0.0f);
+            for (int k = 0; k < 4; ++k)
+            {
+                pic.x += su.weight[k] * u[su.index[k]];
+                pic.y += sv.weight[k] * v[sv.index[k]];
+                delta.x += su.weight[k] * (u[su.index[k]] - uPrevious[su.index[k]]);
+                delta.y += sv.weight[k] * (v[sv.index[k]] - vPrevious[sv.index[k]]);
+                cx += su.gradient[k] * u[su.index[k]];
+                cy += sv.gradient[k] * v[sv.index[k]];
+            }
+
+            glm::vec2 flip = particle.velocity + delta;
+            particle.velocity = flipRatio * flip + (1.0f - flipRatio) * pic;
+            if (apic)
+            {
+                affineX[p] = cx;
+                affineY[p] = cy;
+            }
+        } });
+}
+
+void FlipSolver::advect(std::vector<Particle> &particles, float deltaTime)
+{
+    // keep particles out of the wall layer
+    const glm::vec2 lower = minCorner + glm::vec2(cellSize * 1.001f);
+    const glm::vec2 upper = minCorner + glm::vec2(nx - 1, ny - 1) * cellSize - glm::vec2(cellSize * 0.001f);
+
+    forRange(particles.size(), [&](size_t begin, size_t end)
+             {
+        for (size_t p = begin; p < end; ++p)
+        {
+            Particle &particle = particles[p];
+            particle.position += particle.velocity * deltaTime;
+
+            if (boundaryField)
+            {
+                float distance;
+                glm::vec2 normal;
+                boundaryField->sample(particle.position, distance, normal);
+                if (distance < 0.0f)
+                {
+                    particle.position -= normal * distance;
+                    particle.velocity -= normal * std::min(glm::dot(particle.velocity, normal), 0.0f);
+                }
+            }
+            particle.position = glm::clamp(particle.position, lower, upper);
+
+            // keep the Verlet state consistent so Simulation can pick the particles up again
+            particle.setPrevious(particle.position - particle.velocity * deltaTime);
+        } });
+}
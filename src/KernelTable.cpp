@@ -0,0 +1,96 @@
+#include "KernelTable.h"
+
+#include <cmath>
+#include <algorithm>
+
+KernelTable::KernelTable(KernelShape shape)
+    : shape(shape)
+{
+    // tabulate at h = 1, value() and gradient() rescale by powers of 1 / h
+    for (int i = 0; i <= samples; ++i)
+    {
+        float x = static_cast<float>(i) / samples;
+        values[i] = analyticValue(shape, std::sqrt(x), 1.0f);
+        gradients[i] = analyticGradient(shape, x, 1.0f);
+    }
+}
+
+float KernelTable::analyticValue(KernelShape shape, float r, float h)
+{
+    if (r >= h)
+        return 0.0f;
+    const float q = r / h;
+    const float h2 = h * h;
+    switch (shape)
+    {
+    case KernelShape::Poly6Spiky:
+    {
+        float diff = 1.0f - q * q;
+        return 4.0f / (M_PI * h2) * diff * diff * diff;
+    }
+    case KernelShape::CubicSpline:
+    {
+        float sigma = 40.0f / (7.0f * M_PI * h2);
+        if (q <= 0.5f)
+            return sigma * (6.0f * (q * q * q - q * q) + 1.0f);
+        float diff = 1.0f - q;
+        return sigma * 2.0f * diff * diff * diff;
+    }
+    case KernelShape::WendlandC2:
+    {
+        float diff = 1.0f - q;
+        float diff2 = diff * diff;
+        return 7.0f / (M_PI * h2) * diff2 * diff2 * (1.0f + 4.0f * q);
+    }
+    }
+    return 0.0f;
+}
+
+float KernelTable::analyticGradient(KernelShape shape, float r, float h)
+{
+    if (r >= h)
+        return 0.0f;
+    const float q = r / h;
+    const float h3 = h * h * h;
+    switch (shape)
+    {
+    case KernelShape::Poly6Spiky:
+    {
+        float diff = 1.0f - q;
+        return -30.0f / (M_PI * h3) * diff * diff;
+    }
+    case KernelShape::CubicSpline:
+    {
+        float sigma = 40.0f / (7.0f * M_PI * h3);
+        if (q <= 0.5f)
+            return sigma * 6.0f * (3.0f * q * q - 2.0f * q);
+        float diff = 1.0f - q;
+        return -sigma * 6.0f * diff * diff;
+    }
+    case KernelShape::WendlandC2:
+    {
+        float diff = 1.0f - q;
+        return -140.0f / (M_PI * h3) * q * diff * diff * diff;
+    }
+    }
+    return 0.0f;
+}
+
+void KernelTable::validate(float &valueError, float &gradientError, int sweep) const
+{
+    float peakValue = 0.0f, peakGradient = 0.0f;
+    valueError = 0.0f;
+    gradientError = 0.0f;
+    for (int i = 0; i <= sweep; ++i)
+    {
+        float r = static_cast<float>(i) / sweep;
+        float exactValue = analyticValue(shape, r, 1.0f);
+        float exactGradient = analyticGradient(shape, r, 1.0f);
+        peakValue = std::max(peakValue, std::abs(exactValue));
+        peakGradient = std::max(peakGradient, std::abs(exactGradient));
+        valueError = std::max(valueError, std::abs(value(r * r, 1.0f) - exactValue));
+        gradientError = std::max(gradientError, std::abs(gradient(r, 1.0f) - exactGradient));
+    }
+    valueError /= peakValue;
+    gradientError /= peakGradient;
+}
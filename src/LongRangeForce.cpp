@@ -0,0 +1,190 @@
+#include "LongRangeForce.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+    constexpr uint32_t leafCapacity = 8;
+    constexpr int maxDepth = 24;     // guards against coincident particles
+    constexpr int maxStackSize = 4 * maxDepth + 4;
+}
+
+LongRangeForce::LongRangeForce(Interaction interaction, float strength, float openingAngle, float softening)
+    : interaction(interaction), strength(strength), openingAngle(openingAngle), softening(softening), pool(nullptr)
+{
+}
+
+void LongRangeForce::setOpeningAngle(float theta)
+{
+    openingAngle = theta;
+}
+
+void LongRangeForce::setThreadPool(ThreadPool *threadPool)
+{
+    pool = threadPool;
+}
+
+void LongRangeForce::subdivide(int nodeIndex, int depth)
+{
+    Node node = nodes[nodeIndex];
+    if (node.end - node.begin <= leafCapacity || depth >= maxDepth)
+        return;
+
+    // split the particle range into quadrants: first by y, then each half by x
+    auto first = order.begin() + node.begin;
+    auto last = order.begin() + node.end;
+    auto splitY = std::partition(first, last, [&](uint32_t p)
+                                 { return positions[p].y < node.center.y; });
+    auto splitBottom = std::partition(first, splitY, [&](uint32_t p)
+                                      { return positions[p].x < node.center.x; });
+    auto splitTop = std::partition(splitY, last, [&](uint32_t p)
+                                   { return positions[p].x < node.center.x; });
+    const uint32_t bounds[5] = {node.begin,
+                                static_cast<uint32_t>(splitBottom - order.begin()),
+                                static_cast<uint32_t>(splitY - order.begin()),
+                                static_cast<uint32_t>(splitTop - order.begin()),
+                                node.end};
+
+    const int firstChild = static_cast<int>(nodes.size());
+    nodes[nodeIndex].firstChild = firstChild;
+    const float quarter = node.halfSize * 0.5f;
+    for (int c = 0; c < 4; ++c)
+    {
+        Node child;
+        child.center = node.center + glm::vec2((c & 1) ? quarter : -quarter, (c & 2) ? quarter : -quarter);
+        child.halfSize = quarter;
+        child.firstChild = -1;
+        child.begin = bounds[c];
+        child.end = bounds[c + 1];
+        child.mass = 0.0f;
+        child.centerOfMass = child.center;
+        nodes.push_back(child);
+    }
+    for (int c = 0; c < 4; ++c)
+        subdivide(firstChild + c, depth + 1);
+}
+
+template <typename Real>
+void LongRangeForce::compute(const std::vector<BasicParticle<Real>> &particles, float particleMass)
+{
+    const uint32_t count = static_cast<uint32_t>(particles.size());
+    positions.resize(count);
+    masses.resize(count);
+    order.resize(count);
+    accelerations.assign(count, glm::vec2(0.0f));
+    nodes.clear();
+    if (count == 0)
+        return;
+
+    glm::vec2 lower(std::numeric_limits<float>::max());
+    glm::vec2 upper(-std::numeric_limits<float>::max());
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        positions[i] = glm::vec2(particles[i].position);
+        masses[i] = particleMass * float(particles[i].sizeScale) * float(particles[i].sizeScale);
+        order[i] = i;
+        lower = glm::min(lower, positions[i]);
+        upper = glm::max(upper, positions[i]);
+    }
+
+    Node root;
+    root.center = 0.5f * (lower + upper);
+    root.halfSize = 0.5f * std::max(upper.x - lower.x, upper.y - lower.y) + 1e-6f;
+    root.firstChild = -1;
+    root.begin = 0;
+    root.end = count;
+    nodes.push_back(root);
+    subdivide(0, 0);
+
+    // children are always stored after their parent, so a reverse sweep accumulates bottom up
+    for (int n = static_cast<int>(nodes.size()) - 1; n >= 0; --n)
+    {
+        Node &node = nodes[n];
+        float mass = 0.0f;
+        glm::vec2 weighted(0.0f);
+        if (node.firstChild < 0)
+        {
+            for (uint32_t k = node.begin; k < node.end; ++k)
+            {
+                mass += masses[order[k]];
+                weighted += positions[order[k]] * masses[order[k]];
+            }
+        }
+        else
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                const Node &child = nodes[node.firstChild + c];
+                mass += child.mass;
+                weighted += child.centerOfMass * child.mass;
+            }
+        }
+        node.mass = mass;
+        node.centerOfMass = mass > 0.0f ? weighted / mass : node.center;
+    }
+
+    auto evaluateRange = [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+            accelerations[i] = evaluate(positions[i], static_cast<uint32_t>(i));
+    };
+    if (pool)
+        pool->parallelFor(0, count, evaluateRange);
+    else
+        evaluateRange(0, count);
+}
+
+template void LongRangeForce::compute(const std::vector<Particle> &particles, float particleMass);
+template void LongRangeForce::compute(const std::vector<ParticleD> &particles, float particleMass);
+
+glm::vec2 LongRangeForce::evaluate(const glm::vec2 &pos, uint32_t self) const
+{
+    const float sign = interaction == Interaction::Gravity ? 1.0f : -1.0f;
+    const float softeningSq = softening * softening;
+    const float thetaSq = openingAngle * openingAngle;
+
+    // softened inverse square pull towards source
+    auto pull = [&](const glm::vec2 &source, float mass)
+    {
+        glm::vec2 d = source - pos;
+        float r2 = glm::dot(d, d) + softeningSq;
+        float inverseR = 1.0f / std::sqrt(r2);
+        return d * (mass * inverseR * inverseR * inverseR);
+    };
+
+    glm::vec2 acceleration(0.0f);
+    int stack[maxStackSize];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node &node = nodes[stack[--top]];
+        if (node.mass == 0.0f)
+            continue;
+
+        glm::vec2 d = node.centerOfMass - pos;
+        float distSq = glm::dot(d, d);
+        float size = 2.0f * node.halfSize;
+        // far enough away (size / distance < theta): one body at the centre of mass
+        if (size * size < thetaSq * distSq)
+        {
+            acceleration += pull(node.centerOfMass, node.mass);
+        }
+        else if (node.firstChild < 0)
+        {
+            for (uint32_t k = node.begin; k < node.end; ++k)
+            {
+                uint32_t j = order[k];
+                if (j != self)
+                    acceleration += pull(positions[j], masses[j]);
+            }
+        }
+        else
+        {
+            for (int c = 0; c < 4; ++c)
+                stack[top++] = node.firstChild + c;
+        }
+    }
+    return acceleration * (sign * strength);
+}
@@ -0,0 +1,254 @@
+#include "MultigridSolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+MultigridSolver::MultigridSolver(int nx, int ny, ThreadPool *pool)
+    : pool(pool), tolerance(1e-4f), maxCycles(20), preSmoothing(2), postSmoothing(2), coarseIterations(40)
+{
+    // halve until the coarsest grid is a few cells across, where plain smoothing converges quickly
+    while (true)
+    {
+        Level level;
+        level.nx = nx;
+        level.ny = ny;
+        level.cellType.assign(nx * ny, CellType::Solid);
+        level.solution.assign(nx * ny, 0.0f);
+        level.rhs.assign(nx * ny, 0.0f);
+        level.residual.assign(nx * ny, 0.0f);
+        levels.push_back(std::move(level));
+        if (std::min(nx, ny) <= 4)
+            break;
+        nx = (nx + 1) / 2;
+        ny = (ny + 1) / 2;
+    }
+    rowNorms.assign(levels[0].ny, 0.0f);
+}
+
+void MultigridSolver::setTolerance(float relative)
+{
+    tolerance = relative;
+}
+
+void MultigridSolver::setMaxCycles(int cycles)
+{
+    maxCycles = cycles;
+}
+
+void MultigridSolver::setSmoothing(int pre, int post)
+{
+    preSmoothing = pre;
+    postSmoothing = post;
+}
+
+void MultigridSolver::forRows(int rows, const std::function<void(int)> &body)
+{
+    if (pool == nullptr)
+    {
+        for (int j = 0; j < rows; ++j)
+            body(j);
+        return;
+    }
+    pool->parallelFor(0, rows, [&](size_t begin, size_t end)
+                      {
+        for (size_t j = begin; j < end; ++j)
+            body(static_cast<int>(j)); });
+}
+
+// cells outside the grid behave like walls
+static inline bool openCell(const std::vector<CellType> &cellType, int nx, int ny, int i, int j)
+{
+    return i >= 0 && j >= 0 && i < nx && j < ny && cellType[j * nx + i] != CellType::Solid;
+}
+
+void MultigridSolver::smooth(Level &level, int iterations)
+{
+    const int nx = level.nx;
+    const int ny = level.ny;
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        // cells of one colour only read the other colour, so rows can run concurrently
+        for (int color = 0; color < 2; ++color)
+        {
+            forRows(ny, [&](int j)
+                    {
+                for (int i = (j + color) & 1; i < nx; i += 2)
+                {
+                    int cell = j * nx + i;
+                    if (level.cellType[cell] != CellType::Fluid)
+                        continue;
+
+                    float sum = 0.0f;
+                    int count = 0;
+                    const int neighbors[4][2] = {{i - 1, j}, {i + 1, j}, {i, j - 1}, {i, j + 1}};
+                    for (const auto &n : neighbors)
+                    {
+                        if (!openCell(level.cellType, nx, ny, n[0], n[1]))
+                            continue;
+                        sum += level.solution[n[1] * nx + n[0]]; // air cells hold zero
+                        ++count;
+                    }
+                    if (count > 0)
+                        level.solution[cell] = (level.rhs[cell] + sum) / count;
+                } });
+        }
+    }
+}
+
+float MultigridSolver::computeResidual(Level &level)
+{
+    const int nx = level.nx;
+    const int ny = level.ny;
+    forRows(ny, [&](int j)
+            {
+        float rowMax = 0.0f;
+        for (int i = 0; i < nx; ++i)
+        {
+            int cell = j * nx + i;
+            level.residual[cell] = 0.0f;
+            if (level.cellType[cell] != CellType::Fluid)
+                continue;
+
+            float sum = 0.0f;
+            int count = 0;
+            const int neighbors[4][2] = {{i - 1, j}, {i + 1, j}, {i, j - 1}, {i, j + 1}};
+            for (const auto &n : neighbors)
+            {
+                if (!openCell(level.cellType, nx, ny, n[0], n[1]))
+                    continue;
+                sum += level.solution[n[1] * nx + n[0]];
+                ++count;
+            }
+            // isolated cells have no equation to satisfy
+            if (count == 0)
+                continue;
+            level.residual[cell] = level.rhs[cell] - (count * level.solution[cell] - sum);
+            rowMax = std::max(rowMax, std::abs(level.residual[cell]));
+        }
+        rowNorms[j] = rowMax; });
+
+    return *std::max_element(rowNorms.begin(), rowNorms.begin() + ny);
+}
+
+void MultigridSolver::restrict(const Level &fine, Level &coarse)
+{
+    // The stencil is unscaled by h^2, so the coarse right hand side (spacing 2h) is four times
+    // the average child residual, i.e. their sum.
+    forRows(coarse.ny, [&](int J)
+            {
+        for (int I = 0; I < coarse.nx; ++I)
+        {
+            float sum = 0.0f;
+            for (int c = 0; c < 4; ++c)
+            {
+                int i = 2 * I + (c & 1);
+                int j = 2 * J + (c >> 1);
+                if (i < fine.nx && j < fine.ny)
+                    sum += fine.residual[j * fine.nx + i];
+            }
+            int cell = J * coarse.nx + I;
+            coarse.rhs[cell] = coarse.cellType[cell] == CellType::Fluid ? sum : 0.0f;
+            coarse.solution[cell] = 0.0f;
+        } });
+}
+
+// Bilinear interpolation of the coarse correction (weights 9/16, 3/16, 3/16, 1/16), solid coarse cells
+// drop out and the remaining weights are renormalized, air cells contribute their zero correction
+void MultigridSolver::prolongate(const Level &coarse, Level &fine)
+{
+    forRows(fine.ny, [&](int j)
+            {
+        const int J = j / 2;
+        const int dj = (j & 1) ? 1 : -1;
+        for (int i = 0; i < fine.nx; ++i)
+        {
+            int cell = j * fine.nx + i;
+            if (fine.cellType[cell] != CellType::Fluid)
+                continue;
+
+            const int I = i / 2;
+            const int di = (i & 1) ? 1 : -1;
+            const int taps[4][2] = {{I, J}, {I + di, J}, {I, J + dj}, {I + di, J + dj}};
+            const float weights[4] = {9.0f, 3.0f, 3.0f, 1.0f};
+            float sum = 0.0f;
+            float weightSum = 0.0f;
+            for (int t = 0; t < 4; ++t)
+            {
+                if (!openCell(coarse.cellType, coarse.nx, coarse.ny, taps[t][0], taps[t][1]))
+                    continue;
+                sum += weights[t] * coarse.solution[taps[t][1] * coarse.nx + taps[t][0]];
+                weightSum += weights[t];
+            }
+            if (weightSum > 0.0f)
+                fine.solution[cell] += sum / weightSum;
+        } });
+}
+
+void MultigridSolver::vCycle(size_t depth)
+{
+    Level &level = levels[depth];
+    if (depth + 1 == levels.size())
+    {
+        smooth(level, coarseIterations);
+        return;
+    }
+
+    smooth(level, preSmoothing);
+    computeResidual(level);
+    restrict(level, levels[depth + 1]);
+    vCycle(depth + 1);
+    prolongate(levels[depth + 1], level);
+    smooth(level, postSmoothing);
+}
+
+PoissonStats MultigridSolver::solve(const std::vector<CellType> &cellType, const std::vector<float> &rhs, std::vector<float> &pressure)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    Level &finest = levels[0];
+    finest.cellType = cellType;
+    finest.rhs = rhs;
+    for (size_t cell = 0; cell < pressure.size(); ++cell)
+        finest.solution[cell] = cellType[cell] == CellType::Fluid ? pressure[cell] : 0.0f;
+
+    // Coarse masks: any air child makes the coarse cell air so the free surface condition survives
+    // coarsening, otherwise any fluid child makes it fluid, otherwise it is solid
+    for (size_t depth = 1; depth < levels.size(); ++depth)
+    {
+        const Level &fine = levels[depth - 1];
+        Level &coarse = levels[depth];
+        forRows(coarse.ny, [&](int J)
+                {
+            for (int I = 0; I < coarse.nx; ++I)
+            {
+                bool air = false, fluid = false;
+                for (int c = 0; c < 4; ++c)
+                {
+                    int i = 2 * I + (c & 1);
+                    int j = 2 * J + (c >> 1);
+                    if (i >= fine.nx || j >= fine.ny)
+                        continue;
+                    CellType type = fine.cellType[j * fine.nx + i];
+                    air |= type == CellType::Air;
+                    fluid |= type == CellType::Fluid;
+                }
+                coarse.cellType[J * coarse.nx + I] = air ? CellType::Air : fluid ? CellType::Fluid : CellType::Solid;
+            } });
+    }
+
+    PoissonStats stats;
+    stats.cycles = 0;
+    stats.initialResidual = computeResidual(finest);
+    stats.finalResidual = stats.initialResidual;
+    while (stats.cycles < maxCycles && stats.finalResidual > tolerance * stats.initialResidual)
+    {
+        vCycle(0);
+        ++stats.cycles;
+        stats.finalResidual = computeResidual(finest);
+    }
+
+    pressure = finest.solution;
+    stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
@@ -0,0 +1,171 @@
+#include "Numa.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef __linux__
+    constexpr int moveFlag = 1 << 1; // MPOL_MF_MOVE, without pulling in numaif.h
+
+    // "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+    std::vector<int> parseCpuList(const std::string &text)
+    {
+        std::vector<int> cpus;
+        std::stringstream stream(text);
+        std::string range;
+        while (std::getline(stream, range, ','))
+        {
+            if (range.empty() || range[0] == '\n')
+                continue;
+            size_t dash = range.find('-');
+            int first = std::atoi(range.c_str());
+            int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+            for (int cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+#endif
+}
+
+namespace numa
+{
+    Topology topology()
+    {
+        Topology result;
+#ifdef __linux__
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+            return result;
+
+        // node directories can be sparse, e.g. node0 and node2
+        std::vector<int> ids;
+        if (DIR *dir = opendir("/sys/devices/system/node"))
+        {
+            while (dirent *entry = readdir(dir))
+            {
+                if (std::string(entry->d_name).compare(0, 4, "node") == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+                    ids.push_back(std::atoi(entry->d_name + 4));
+            }
+            closedir(dir);
+        }
+        std::sort(ids.begin(), ids.end());
+
+        for (int id : ids)
+        {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            std::string text;
+            std::getline(file, text);
+            bool used = false;
+            for (int cpu : parseCpuList(text))
+            {
+                if (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed))
+                    continue;
+                result.cpus.push_back(cpu);
+                result.cpuNode.push_back(static_cast<int>(result.nodeIds.size()));
+                used = true;
+            }
+            if (used)
+                result.nodeIds.push_back(id);
+        }
+
+        // no sysfs node information: one node with every allowed CPU
+        if (result.cpus.empty())
+        {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (CPU_ISSET(cpu, &allowed))
+                {
+                    result.cpus.push_back(cpu);
+                    result.cpuNode.push_back(0);
+                }
+            }
+            result.nodeIds.assign(1, 0);
+        }
+#endif
+        return result;
+    }
+
+    bool pinCurrentThread(int cpu)
+    {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void)cpu;
+        return false;
+#endif
+    }
+
+    std::vector<int> currentThreadCpus()
+    {
+        std::vector<int> cpus;
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            return cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+        }
+#endif
+        return cpus;
+    }
+
+    bool setCurrentThreadCpus(const std::vector<int> &cpus)
+    {
+#ifdef __linux__
+        if (cpus.empty())
+            return false;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+            CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void)cpus;
+        return false;
+#endif
+    }
+
+    bool movePages(const void *data, size_t bytes, int node)
+    {
+#ifdef __linux__
+        const uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        const uintptr_t first = reinterpret_cast<uintptr_t>(data) & ~(pageSize - 1);
+        const uintptr_t last = reinterpret_cast<uintptr_t>(data) + bytes;
+        if (bytes == 0)
+            return true;
+
+        std::vector<void *> pages;
+        for (uintptr_t page = first; page < last; page += pageSize)
+            pages.push_back(reinterpret_cast<void *>(page));
+        std::vector<int> nodes(pages.size(), node);
+        std::vector<int> status(pages.size());
+        return syscall(SYS_move_pages, 0, pages.size(), pages.data(), nodes.data(), status.data(), moveFlag) == 0;
+#else
+        (void)data;
+        (void)bytes;
+        (void)node;
+        return false;
+#endif
+    }
+}
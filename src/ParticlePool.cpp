@@ -0,0 +1,115 @@
+#include "ParticlePool.h"
+
+#include <functional>
+
+ParticlePool::ParticlePool(size_t capacity)
+    : capacity(capacity), nozzlePhase(0.0f)
+{
+    particles.reserve(capacity);
+    freeList.reserve(capacity);
+    dead.reserve(capacity);
+}
+
+void ParticlePool::assign(const std::vector<Particle> &initial)
+{
+    particles.clear();
+    freeList.clear();
+    particles.insert(particles.end(), initial.begin(), initial.begin() + std::min(initial.size(), capacity));
+    dead.assign(particles.size(), 0);
+}
+
+void ParticlePool::addEmitter(const Emitter &emitter)
+{
+    emitters.push_back(emitter);
+}
+
+void ParticlePool::addSink(const Sink &sink)
+{
+    sinks.push_back(sink);
+}
+
+void ParticlePool::kill(uint32_t index)
+{
+    // a slot freed twice would make compact() pop a live particle
+    if (index >= particles.size() || dead[index])
+        return;
+    dead[index] = 1;
+    freeList.push_back(index);
+}
+
+bool ParticlePool::spawn(const glm::vec2 &pos, const glm::vec2 &vel, float deltaTime)
+{
+    Particle particle(pos, vel);
+    // Verlet derives velocity from the last step's displacement, so back-date the previous position
+    particle.setPrevious(pos - vel * deltaTime);
+
+    if (!freeList.empty())
+    {
+        particles[freeList.back()] = particle;
+        dead[freeList.back()] = 0;
+        freeList.pop_back();
+        return true;
+    }
+    if (particles.size() < capacity)
+    {
+        particles.push_back(particle); // within the reserved capacity, never reallocates
+        dead.push_back(0);
+        return true;
+    }
+    return false;
+}
+
+void ParticlePool::compact()
+{
+    // Fill holes from the highest index down so the element moved in from the back is always live
+    std::sort(freeList.begin(), freeList.end(), std::greater<uint32_t>());
+    for (uint32_t hole : freeList)
+    {
+        if (hole != particles.size() - 1)
+            particles[hole] = particles.back();
+        particles.pop_back();
+        dead[hole] = 0;
+        dead.pop_back();
+    }
+    freeList.clear();
+}
+
+void ParticlePool::update(float deltaTime)
+{
+    for (uint32_t i = 0; i < particles.size(); ++i)
+    {
+        const glm::vec2 &pos = particles[i].position;
+        for (const auto &sink : sinks)
+        {
+            if (pos.x >= sink.minCorner.x && pos.x <= sink.maxCorner.x &&
+                pos.y >= sink.minCorner.y && pos.y <= sink.maxCorner.y)
+            {
+                kill(i);
+                break;
+            }
+        }
+    }
+
+    for (auto &emitter : emitters)
+    {
+        emitter.accumulator += emitter.rate * deltaTime;
+        glm::vec2 across(-emitter.direction.y, emitter.direction.x);
+        while (emitter.accumulator >= 1.0f)
+        {
+            // golden ratio sequence spreads consecutive particles evenly across the nozzle
+            nozzlePhase += 0.618034f;
+            if (nozzlePhase >= 1.0f)
+                nozzlePhase -= 1.0f;
+            glm::vec2 pos = emitter.position + across * (emitter.width * (nozzlePhase - 0.5f));
+            if (!spawn(pos, emitter.direction * emitter.speed, deltaTime))
+            {
+                // pool is full: drop the backlog instead of bursting once space frees up
+                emitter.accumulator = 0.0f;
+                break;
+            }
+            emitter.accumulator -= 1.0f;
+        }
+    }
+
+    compact();
+}
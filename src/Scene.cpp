@@ -0,0 +1,587 @@
+#include "Scene.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    struct JsonValue
+    {
+        enum Type
+        {
+            Null,
+            Boolean,
+            Number,
+            String,
+            Array,
+            Object
+        };
+
+        Type type = Null;
+        bool boolean = false;
+        double number = 0.0;
+        std::string string;
+        std::vector<JsonValue> items;
+        std::vector<std::pair<std::string, JsonValue>> members;
+        int line = 0;
+    };
+
+    // Minimal JSON reader: the full grammar, without \u escapes beyond ASCII, numbers as doubles
+    class JsonParser
+    {
+    private:
+        const std::string &text;
+        std::string filename;
+        size_t position;
+        int line;
+
+        [[noreturn]] void fail(const std::string &message) const
+        {
+            throw std::runtime_error(filename + ":" + std::to_string(line) + ": " + message);
+        }
+
+        void skipSpace()
+        {
+            while (position < text.size())
+            {
+                char c = text[position];
+                if (c == '\n')
+                    ++line;
+                else if (c != ' ' && c != '\t' && c != '\r')
+                    return;
+                ++position;
+            }
+        }
+
+        bool consume(char expected)
+        {
+            skipSpace();
+            if (position < text.size() && text[position] == expected)
+            {
+                ++position;
+                return true;
+            }
+            return false;
+        }
+
+        void expect(char expected)
+        {
+            if (!consume(expected))
+                fail(std::string("expected '") + expected + "'");
+        }
+
+        std::string parseString()
+        {
+            expect('"');
+            std::string result;
+            while (position < text.size() && text[position] != '"')
+            {
+                char c = text[position++];
+                if (c == '\n')
+                    fail("unterminated string");
+                if (c != '\\')
+                {
+                    result += c;
+                    continue;
+                }
+                if (position >= text.size())
+                    break;
+                char escape = text[position++];
+                switch (escape)
+                {
+                case '"':
+                case '\\':
+                case '/':
+                    result += escape;
+                    break;
+                case 'b':
+                    result += '\b';
+                    break;
+                case 'f':
+                    result += '\f';
+                    break;
+                case 'n':
+                    result += '\n';
+                    break;
+                case 'r':
+                    result += '\r';
+                    break;
+                case 't':
+                    result += '\t';
+                    break;
+                case 'u':
+                {
+                    if (position + 4 > text.size())
+                        fail("bad \\u escape");
+                    char *end = nullptr;
+                    const std::string digits = text.substr(position, 4);
+                    long code = std::strtol(digits.c_str(), &end, 16);
+                    if (end != digits.c_str() + 4 || code > 0x7F)
+                        fail("only ASCII \\u escapes are supported");
+                    result += static_cast<char>(code);
+                    position += 4;
+                    break;
+                }
+                default:
+                    fail(std::string("bad escape \\") + escape);
+                }
+            }
+            if (position >= text.size())
+                fail("unterminated string");
+            ++position;
+            return result;
+        }
+
+        JsonValue parseValue()
+        {
+            skipSpace();
+            if (position >= text.size())
+                fail("unexpected end of file");
+
+            JsonValue value;
+            value.line = line;
+            const char c = text[position];
+            if (c == '{')
+            {
+                value.type = JsonValue::Object;
+                ++position;
+                if (consume('}'))
+                    return value;
+                do
+                {
+                    skipSpace();
+                    const int keyLine = line;
+                    std::string key = parseString();
+                    for (const auto &member : value.members)
+                    {
+                        if (member.first == key)
+                        {
+                            line = keyLine;
+                            fail("duplicate key \"" + key + "\"");
+                        }
+                    }
+                    expect(':');
+                    value.members.emplace_back(std::move(key), parseValue());
+                } while (consume(','));
+                expect('}');
+            }
+            else if (c == '[')
+            {
+                value.type = JsonValue::Array;
+                ++position;
+                if (consume(']'))
+                    return value;
+                do
+                    value.items.push_back(parseValue());
+                while (consume(','));
+                expect(']');
+            }
+            else if (c == '"')
+            {
+                value.type = JsonValue::String;
+                value.string = parseString();
+            }
+            else if (text.compare(position, 4, "true") == 0 || text.compare(position, 5, "false") == 0)
+            {
+                value.type = JsonValue::Boolean;
+                value.boolean = text[position] == 't';
+                position += value.boolean ? 4 : 5;
+            }
+            else if (text.compare(position, 4, "null") == 0)
+                position += 4;
+            else
+            {
+                // strtod accepts more than JSON (hex, inf), so check the first character at least
+                if (c != '-' && (c < '0' || c > '9'))
+                    fail(std::string("unexpected '") + c + "'");
+                const char *begin = text.c_str() + position;
+                char *end = nullptr;
+                value.type = JsonValue::Number;
+                value.number = std::strtod(begin, &end);
+                if (end == begin)
+                    fail("bad number");
+                position += end - begin;
+            }
+            return value;
+        }
+
+    public:
+        JsonParser(const std::string &text, const std::string &filename) : text(text), filename(filename), position(0), line(1) {}
+
+        JsonValue parse()
+        {
+            JsonValue root = parseValue();
+            skipSpace();
+            if (position != text.size())
+                fail("trailing characters after the scene");
+            return root;
+        }
+    };
+
+    // Type-checked access to parsed values, errors point at the value's line
+    class SceneReader
+    {
+    private:
+        std::string filename;
+
+    public:
+        explicit SceneReader(const std::string &filename) : filename(filename) {}
+
+        [[noreturn]] void fail(const JsonValue &value, const std::string &message) const
+        {
+            throw std::runtime_error(filename + ":" + std::to_string(value.line) + ": " + message);
+        }
+
+        // Calls read(key, value) for every member, which returns false for keys it does not know
+        template <typename Reader>
+        void object(const JsonValue &value, const char *what, Reader &&read) const
+        {
+            if (value.type != JsonValue::Object)
+                fail(value, std::string(what) + " must be an object");
+            for (const auto &member : value.members)
+            {
+                if (!read(member.first, member.second))
+                    fail(member.second, "unknown key \"" + member.first + "\" in " + what);
+            }
+        }
+
+        double number(const JsonValue &value, const std::string &key) const
+        {
+            if (value.type != JsonValue::Number || !std::isfinite(value.number))
+                fail(value, key + " must be a number");
+            return value.number;
+        }
+
+        float positive(const JsonValue &value, const std::string &key) const
+        {
+            double result = number(value, key);
+            if (!(result > 0.0))
+                fail(value, key + " must be positive");
+            return static_cast<float>(result);
+        }
+
+        float range(const JsonValue &value, const std::string &key, float minimum, float maximum) const
+        {
+            double result = number(value, key);
+            if (!(result >= minimum && result <= maximum))
+            {
+                char bounds[64];
+                std::snprintf(bounds, sizeof(bounds), "%g and %g", minimum, maximum);
+                fail(value, key + " must be between " + bounds);
+            }
+            return static_cast<float>(result);
+        }
+
+        int integer(const JsonValue &value, const std::string &key, int minimum) const
+        {
+            double result = number(value, key);
+            if (result != std::floor(result) || result < minimum || result > 2147483647.0)
+                fail(value, key + " must be an integer of at least " + std::to_string(minimum));
+            return static_cast<int>(result);
+        }
+
+        bool boolean(const JsonValue &value, const std::string &key) const
+        {
+            if (value.type != JsonValue::Boolean)
+                fail(value, key + " must be true or false");
+            return value.boolean;
+        }
+
+        const std::string &string(const JsonValue &value, const std::string &key) const
+        {
+            if (value.type != JsonValue::String)
+                fail(value, key + " must be a string");
+            return value.string;
+        }
+
+        glm::vec2 vec2(const JsonValue &value, const std::string &key) const
+        {
+            if (value.type != JsonValue::Array || value.items.size() != 2)
+                fail(value, key + " must be an [x, y] array");
+            return glm::vec2(number(value.items[0], key), number(value.items[1], key));
+        }
+
+        const std::vector<JsonValue> &array(const JsonValue &value, const std::string &key) const
+        {
+            if (value.type != JsonValue::Array)
+                fail(value, key + " must be an array");
+            return value.items;
+        }
+
+        // Case-insensitive choice between names, returns the index
+        size_t choice(const JsonValue &value, const std::string &key, const std::vector<const char *> &names) const
+        {
+            std::string lower = string(value, key);
+            for (char &c : lower)
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            std::string options;
+            for (size_t i = 0; i < names.size(); ++i)
+            {
+                if (lower == names[i])
+                    return i;
+                options += (i > 0 ? ", " : "") + std::string(names[i]);
+            }
+            fail(value, key + " must be one of " + options);
+        }
+
+        // {"type": "box", "min": [x, y], "max": [x, y]}, {"type": "circle", "center": [x, y], "radius": r}
+        // or {"type": "polygon", "points": [[x, y], ...]}
+        Polyline shape(const JsonValue &value) const
+        {
+            std::string type = "polygon";
+            glm::vec2 min(0.0f), max(0.0f), center(0.0f);
+            float radius = 0.0f;
+            int segments = 32;
+            Polyline points;
+            object(value, "shape", [&](const std::string &key, const JsonValue &member)
+            {
+                if (key == "type")
+                    type = string(member, key);
+                else if (key == "min")
+                    min = vec2(member, key);
+                else if (key == "max")
+                    max = vec2(member, key);
+                else if (key == "center")
+                    center = vec2(member, key);
+                else if (key == "radius")
+                    radius = positive(member, key);
+                else if (key == "segments")
+                    segments = integer(member, key, 3);
+                else if (key == "points")
+                {
+                    for (const JsonValue &point : array(member, key))
+                        points.push_back(vec2(point, key));
+                }
+                else
+                    return false;
+                return true;
+            });
+
+            if (type == "box")
+            {
+                if (!(min.x < max.x && min.y < max.y))
+                    fail(value, "box min must be below max");
+                return Polyline{min, glm::vec2(max.x, min.y), max, glm::vec2(min.x, max.y)};
+            }
+            if (type == "circle")
+            {
+                if (radius <= 0.0f)
+                    fail(value, "circle needs a radius");
+                Polyline circle;
+                for (int i = 0; i < segments; ++i)
+                {
+                    float angle = 2.0f * 3.14159265f * i / segments;
+                    circle.push_back(center + radius * glm::vec2(std::cos(angle), std::sin(angle)));
+                }
+                return circle;
+            }
+            if (type == "polygon")
+            {
+                if (points.size() < 3)
+                    fail(value, "polygon needs at least 3 points");
+                return points;
+            }
+            fail(value, "shape type must be box, circle or polygon");
+        }
+    };
+}
+
+SceneSettings loadScene(const char *filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+        throw std::runtime_error(std::string("Could not open scene file: ") + filename);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    const std::string text = contents.str();
+
+    const JsonValue root = JsonParser(text, filename).parse();
+    const SceneReader reader(filename);
+    SceneSettings scene;
+    bool boundaryGiven = false;
+
+    reader.object(root, "scene", [&](const std::string &section, const JsonValue &value)
+    {
+        if (section == "window")
+        {
+            reader.object(value, "window", [&](const std::string &key, const JsonValue &member)
+            {
+                if (key == "width")
+                    scene.windowWidth = reader.integer(member, key, 1);
+                else if (key == "height")
+                    scene.windowHeight = reader.integer(member, key, 1);
+                else
+                    return false;
+                return true;
+            });
+        }
+        else if (section == "physics")
+        {
+            reader.object(value, "physics", [&](const std::string &key, const JsonValue &member)
+            {
+                if (key == "mass")
+                    scene.mass = reader.positive(member, key);
+                else if (key == "damping")
+                    scene.damping = static_cast<float>(reader.number(member, key));
+                else if (key == "timeStep")
+                    scene.timeStep = reader.positive(member, key);
+                else if (key == "radius")
+                    scene.radius = reader.positive(member, key);
+                else if (key == "targetDensity")
+                    scene.targetDensity = reader.positive(member, key);
+                else if (key == "pressureMultiplier")
+                    scene.pressureMultiplier = static_cast<float>(reader.number(member, key));
+                else if (key == "mouseForce")
+                    scene.mouseForce = static_cast<float>(reader.number(member, key));
+                else
+                    return false;
+                return true;
+            });
+        }
+        else if (section == "solver")
+        {
+            reader.object(value, "solver", [&](const std::string &key, const JsonValue &member)
+            {
+                if (key == "kernel")
+                    scene.kernel = static_cast<KernelType>(reader.choice(member, key, {"poly6spiky", "cubicspline", "wendlandc2", "tabulated"}));
+                else if (key == "integrator")
+                    scene.integrator = static_cast<IntegratorType>(reader.choice(member, key, {"verlet", "leapfrog", "symplecticeuler"}));
+                else if (key == "boundary")
+                {
+                    scene.boundary = static_cast<BoundaryType>(reader.choice(member, key, {"box", "periodic", "sdf", "open"}));
+                    boundaryGiven = true;
+                }
+                else if (key == "precision")
+                    scene.mixedPrecision = reader.choice(member, key, {"single", "mixed"}) == 1;
+                else if (key == "periodic")
+                {
+                    const std::vector<JsonValue> &axes = reader.array(member, key);
+                    if (axes.size() != 2)
+                        reader.fail(member, "periodic must be [x, y]");
+                    scene.periodicX = reader.boolean(axes[0], key);
+                    scene.periodicY = reader.boolean(axes[1], key);
+                }
+                else if (key == "threads")
+                    scene.threads = static_cast<unsigned>(reader.integer(member, key, 0));
+                else if (key == "seed")
+                    scene.seed = static_cast<unsigned>(reader.integer(member, key, 0));
+                else if (key == "numa")
+                    scene.numa = reader.boolean(member, key);
+                else if (key == "sdfResolution")
+                    scene.sdfResolution = reader.integer(member, key, 2);
+                else
+                    return false;
+                return true;
+            });
+        }
+        else if (section == "fluid")
+        {
+            scene.fluid.clear();
+            for (const JsonValue &item : reader.array(value, section))
+            {
+                FluidBlock block;
+                reader.object(item, "fluid block", [&](const std::string &key, const JsonValue &member)
+                {
+                    if (key == "min")
+                        block.min = reader.vec2(member, key);
+                    else if (key == "max")
+                        block.max = reader.vec2(member, key);
+                    else if (key == "particles")
+                        block.particles = reader.integer(member, key, 0);
+                    else if (key == "layout")
+                        block.grid = reader.choice(member, key, {"random", "grid"}) == 1;
+                    else if (key == "velocity")
+                        block.velocity = reader.vec2(member, key);
+                    else
+                        return false;
+                    return true;
+                });
+                if (!(block.min.x < block.max.x && block.min.y < block.max.y))
+                    reader.fail(item, "fluid block min must be below max");
+                scene.fluid.push_back(block);
+            }
+        }
+        else if (section == "obstacles" || section == "containers")
+        {
+            std::vector<Polyline> &shapes = section == "obstacles" ? scene.obstacles : scene.containers;
+            for (const JsonValue &item : reader.array(value, section))
+                shapes.push_back(reader.shape(item));
+        }
+        else if (section == "geometry")
+        {
+            // polylines in the loadPolylines text format, relative to the working directory
+            loadPolylines(reader.string(value, section).c_str(), scene.containers, scene.obstacles);
+        }
+        else if (section == "output")
+        {
+            reader.object(value, "output", [&](const std::string &key, const JsonValue &member)
+            {
+                if (key == "checkpoint")
+                    scene.checkpointFile = reader.string(member, key);
+                else if (key == "trajectory")
+                    scene.trajectoryFile = reader.string(member, key);
+                else if (key == "trajectoryInterval")
+                    scene.trajectoryInterval = static_cast<uint32_t>(reader.integer(member, key, 1));
+                else if (key == "compress")
+                    scene.compressTrajectory = reader.boolean(member, key);
+                else if (key == "errorBound")
+                    scene.compression.errorBound = reader.range(member, key, TrajectoryCodecSettings::minimumErrorBound,
+                                                                TrajectoryCodecSettings::maximumErrorBound);
+                else if (key == "velocityErrorBound")
+                    scene.compression.velocityErrorBound = reader.range(member, key, TrajectoryCodecSettings::minimumErrorBound,
+                                                                        TrajectoryCodecSettings::maximumErrorBound);
+                else if (key == "densityErrorBound")
+                    scene.compression.densityErrorBound = reader.range(member, key, TrajectoryCodecSettings::minimumErrorBound,
+                                                                       TrajectoryCodecSettings::maximumErrorBound);
+                else if (key == "keyframeInterval")
+                    scene.compression.keyframeInterval = static_cast<uint32_t>(reader.integer(member, key, 1));
+                else if (key == "record")
+                    scene.recordAtStart = reader.boolean(member, key);
+                else if (key == "vtk")
+                    scene.vtkBasename = reader.string(member, key);
+                else if (key == "vtkInterval")
+                    scene.vtkInterval = static_cast<uint32_t>(reader.integer(member, key, 0));
+                else
+                    return false;
+                return true;
+            });
+        }
+        else
+            return false;
+        return true;
+    });
+
+    // geometry only acts through the SDF (or open) boundary
+    if (!scene.obstacles.empty() || !scene.containers.empty())
+    {
+        if (!boundaryGiven)
+            scene.boundary = BoundaryType::SDF;
+        else if (scene.boundary != BoundaryType::SDF && scene.boundary != BoundaryType::Open)
+            throw std::runtime_error(std::string(filename) + ": obstacles and containers need the sdf or open boundary");
+    }
+    return scene;
+}
+
+std::vector<Particle> generateScene(const SceneSettings &scene, std::mt19937 &rng)
+{
+    std::vector<Particle> particles;
+    for (const FluidBlock &block : scene.fluid)
+    {
+        std::vector<Particle> filled = block.grid ? generateUniformGridParticles(block.particles, block.min.x, block.max.x, block.min.y, block.max.y)
+                                                  : generateParticles(block.particles, block.min.x, block.max.x, block.min.y, block.max.y, rng);
+        for (Particle &particle : filled)
+        {
+            particle.velocity = block.velocity;
+            // Verlet integrators carry velocity in the previous position
+            particle.setPrevious(particle.position - block.velocity * scene.timeStep);
+        }
+        particles.insert(particles.end(), filled.begin(), filled.end());
+    }
+    return particles;
+}
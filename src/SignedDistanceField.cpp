@@ -0,0 +1,341 @@
+#include "SignedDistanceField.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+SignedDistanceField::SignedDistanceField(glm::vec2 minCorner, glm::vec2 maxCorner, int resolution)
+    : minCorner(minCorner), maxCorner(maxCorner)
+{
+    // keep cells square-ish, resolution is the node count along the longer axis
+    glm::vec2 extent = maxCorner - minCorner;
+    float longest = std::max(extent.x, extent.y);
+    width = std::max(2, static_cast<int>(std::ceil(resolution * extent.x / longest)));
+    height = std::max(2, static_cast<int>(std::ceil(resolution * extent.y / longest)));
+    cellSize = glm::vec2(extent.x / (width - 1), extent.y / (height - 1));
+
+    // no geometry yet: everything is far away from any wall
+    nodes.assign(width * height, glm::vec3(std::numeric_limits<float>::max(), 0.0f, 0.0f));
+}
+
+glm::vec2 SignedDistanceField::nodePosition(int i, int j) const
+{
+    return minCorner + glm::vec2(i * cellSize.x, j * cellSize.y);
+}
+
+static float distanceToSegment(const glm::vec2 &p, const glm::vec2 &a, const glm::vec2 &b)
+{
+    glm::vec2 ab = b - a;
+    float lengthSq = glm::dot(ab, ab);
+    float t = lengthSq > 0.0f ? std::clamp(glm::dot(p - a, ab) / lengthSq, 0.0f, 1.0f) : 0.0f;
+    return glm::length(p - (a + ab * t));
+}
+
+// even-odd crossing test
+static bool insidePolygon(const glm::vec2 &p, const Polyline &polygon)
+{
+    bool inside = false;
+    for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++)
+    {
+        const glm::vec2 &a = polygon[i];
+        const glm::vec2 &b = polygon[j];
+        if ((a.y > p.y) != (b.y > p.y) && p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x)
+            inside = !inside;
+    }
+    return inside;
+}
+
+void SignedDistanceField::bakePolylines(const std::vector<Polyline> &containers, const std::vector<Polyline> &obstacles)
+{
+    // without any edge a container leaves every node solid with no surface to measure a distance to
+    size_t vertices = 0;
+    for (const auto &polygon : containers)
+        vertices += polygon.size();
+    for (const auto &polygon : obstacles)
+        vertices += polygon.size();
+    if (vertices == 0 && !containers.empty())
+        throw std::runtime_error("SDF: the containers have no vertices, the whole domain would be solid");
+
+    // Baking is O(nodes * segments) but only happens once at startup
+    for (int j = 0; j < height; ++j)
+    {
+        for (int i = 0; i < width; ++i)
+        {
+            glm::vec2 p = nodePosition(i, j);
+            float unsignedDistance = std::numeric_limits<float>::max();
+
+            auto visit = [&](const Polyline &polygon)
+            {
+                for (size_t k = 0; k < polygon.size(); ++k)
+                {
+                    const glm::vec2 &a = polygon[k];
+                    const glm::vec2 &b = polygon[(k + 1) % polygon.size()];
+                    unsignedDistance = std::min(unsignedDistance, distanceToSegment(p, a, b));
+                }
+            };
+            for (const auto &polygon : containers)
+                visit(polygon);
+            for (const auto &polygon : obstacles)
+                visit(polygon);
+
+            bool solid = !containers.empty();
+            for (const auto &polygon : containers)
+            {
+                if (polygon.size() >= 3 && insidePolygon(p, polygon))
+                {
+                    solid = false;
+                    break;
+                }
+            }
+            for (const auto &polygon : obstacles)
+            {
+                if (polygon.size() >= 3 && insidePolygon(p, polygon))
+                {
+                    solid = true;
+                    break;
+                }
+            }
+
+            nodes[j * width + i].x = solid ? -unsignedDistance : unsignedDistance;
+        }
+    }
+    computeNormals();
+}
+
+void SignedDistanceField::bakeBitmap(const std::vector<uint8_t> &pixels, int bitmapWidth, int bitmapHeight, uint8_t threshold)
+{
+    // Classify each node by the pixel under it
+    std::vector<bool> solid(width * height);
+    for (int j = 0; j < height; ++j)
+    {
+        for (int i = 0; i < width; ++i)
+        {
+            int px = std::min(bitmapWidth - 1, i * bitmapWidth / width);
+            int py = std::min(bitmapHeight - 1, j * bitmapHeight / height);
+            solid[j * width + i] = pixels[py * bitmapWidth + px] < threshold;
+        }
+    }
+
+    // Seed the interface: nodes with a differently classified 4-neighbor get the midpoint as their closest surface point
+    const float far = std::numeric_limits<float>::max();
+    std::vector<glm::vec2> closest(width * height, glm::vec2(far));
+    std::vector<float> distances(width * height, far);
+    bool seeded = false;
+    const int offsets4[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    for (int j = 0; j < height; ++j)
+    {
+        for (int i = 0; i < width; ++i)
+        {
+            int index = j * width + i;
+            for (const auto &offset : offsets4)
+            {
+                int ni = i + offset[0], nj = j + offset[1];
+                if (ni < 0 || nj < 0 || ni >= width || nj >= height || solid[nj * width + ni] == solid[index])
+                    continue;
+                glm::vec2 midpoint = 0.5f * (nodePosition(i, j) + nodePosition(ni, nj));
+                float d = glm::length(nodePosition(i, j) - midpoint);
+                if (d < distances[index])
+                {
+                    distances[index] = d;
+                    closest[index] = midpoint;
+                    seeded = true;
+                }
+            }
+        }
+    }
+
+    // without a seed every distance stays at the float maximum, which solid nodes turn into NaN positions
+    if (!seeded)
+        throw std::runtime_error("SDF: the bitmap has no solid/fluid boundary at this resolution");
+
+    // Two-pass dead reckoning: propagate closest surface points forwards then backwards
+    auto relax = [&](int i, int j, int ni, int nj)
+    {
+        if (ni < 0 || nj < 0 || ni >= width || nj >= height)
+            return;
+        int index = j * width + i;
+        int neighbor = nj * width + ni;
+        if (distances[neighbor] == far)
+            return;
+        float d = glm::length(nodePosition(i, j) - closest[neighbor]);
+        if (d < distances[index])
+        {
+            distances[index] = d;
+            closest[index] = closest[neighbor];
+        }
+    };
+    for (int j = 0; j < height; ++j)
+    {
+        for (int i = 0; i < width; ++i)
+        {
+            relax(i, j, i - 1, j - 1);
+            relax(i, j, i, j - 1);
+            relax(i, j, i + 1, j - 1);
+            relax(i, j, i - 1, j);
+        }
+    }
+    for (int j = height - 1; j >= 0; --j)
+    {
+        for (int i = width - 1; i >= 0; --i)
+        {
+            relax(i, j, i + 1, j + 1);
+            relax(i, j, i, j + 1);
+            relax(i, j, i - 1, j + 1);
+            relax(i, j, i + 1, j);
+        }
+    }
+
+    for (int index = 0; index < width * height; ++index)
+        nodes[index].x = solid[index] ? -distances[index] : distances[index];
+    computeNormals();
+}
+
+// Normals are the normalized distance gradient, precomputed so sampling needs no finite differences
+void SignedDistanceField::computeNormals()
+{
+    auto distanceAt = [&](int i, int j)
+    {
+        i = std::clamp(i, 0, width - 1);
+        j = std::clamp(j, 0, height - 1);
+        return nodes[j * width + i].x;
+    };
+
+    for (int j = 0; j < height; ++j)
+    {
+        for (int i = 0; i < width; ++i)
+        {
+            glm::vec2 gradient((distanceAt(i + 1, j) - distanceAt(i - 1, j)) / cellSize.x,
+                               (distanceAt(i, j + 1) - distanceAt(i, j - 1)) / cellSize.y);
+            float length = glm::length(gradient);
+            glm::vec2 normal = length > 0.0f ? gradient / length : glm::vec2(0.0f);
+            nodes[j * width + i].y = normal.x;
+            nodes[j * width + i].z = normal.y;
+        }
+    }
+}
+
+void SignedDistanceField::sample(const glm::vec2 &pos, float &distance, glm::vec2 &normal) const
+{
+    // Outside the baked region the field is clamped to its border values. NaN fails both comparisons
+    // and reads the first node, std::clamp would pass it through to the index.
+    glm::vec2 local = (pos - minCorner) / cellSize;
+    float fx = local.x > 0.0f ? std::min(local.x, static_cast<float>(width - 1)) : 0.0f;
+    float fy = local.y > 0.0f ? std::min(local.y, static_cast<float>(height - 1)) : 0.0f;
+    int i = std::min(static_cast<int>(fx), width - 2);
+    int j = std::min(static_cast<int>(fy), height - 2);
+    float tx = fx - i;
+    float ty = fy - j;
+
+    const glm::vec3 &n00 = nodes[j * width + i];
+    const glm::vec3 &n10 = nodes[j * width + i + 1];
+    const glm::vec3 &n01 = nodes[(j + 1) * width + i];
+    const glm::vec3 &n11 = nodes[(j + 1) * width + i + 1];
+    glm::vec3 bottom = n00 * (1.0f - tx) + n10 * tx;
+    glm::vec3 top = n01 * (1.0f - tx) + n11 * tx;
+    glm::vec3 value = bottom * (1.0f - ty) + top * ty;
+
+    distance = value.x;
+    normal = glm::vec2(value.y, value.z);
+    float length = glm::length(normal);
+    if (length > 0.0f)
+        normal /= length;
+}
+
+void loadPolylines(const char *filename, std::vector<Polyline> &containers, std::vector<Polyline> &obstacles)
+{
+    std::ifstream in(filename);
+    if (!in)
+        throw std::runtime_error(std::string("Could not open polyline file: ") + filename);
+
+    Polyline *current = nullptr;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line))
+    {
+        ++lineNumber;
+        std::istringstream tokens(line);
+        std::string first;
+        if (!(tokens >> first) || first[0] == '#')
+            continue;
+
+        if (first == "container")
+        {
+            containers.emplace_back();
+            current = &containers.back();
+        }
+        else if (first == "obstacle")
+        {
+            obstacles.emplace_back();
+            current = &obstacles.back();
+        }
+        else
+        {
+            float x, y;
+            std::istringstream vertex(line);
+            if (current == nullptr || !(vertex >> x >> y))
+                throw std::runtime_error(std::string(filename) + ":" + std::to_string(lineNumber) + ": expected \"x y\" inside a container or obstacle");
+            current->emplace_back(x, y);
+        }
+    }
+}
+
+std::vector<uint8_t> loadPGM(const char *filename, int &width, int &height)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+        throw std::runtime_error(std::string("Could not open bitmap: ") + filename);
+
+    // header tokens may be separated by comments
+    auto nextToken = [&]()
+    {
+        std::string token;
+        while (in >> token)
+        {
+            if (token[0] != '#')
+                return token;
+            std::string comment;
+            std::getline(in, comment);
+        }
+        throw std::runtime_error(std::string("Truncated PGM header: ") + filename);
+    };
+
+    std::string magic = nextToken();
+    if (magic != "P5" && magic != "P2")
+        throw std::runtime_error(std::string("Unsupported bitmap format (expected PGM P2/P5): ") + filename);
+    width = std::stoi(nextToken());
+    height = std::stoi(nextToken());
+    int maxValue = std::stoi(nextToken());
+    if (width <= 0 || height <= 0 || maxValue <= 0 || maxValue > 255)
+        throw std::runtime_error(std::string("Unsupported PGM dimensions or depth: ") + filename);
+
+    std::vector<uint8_t> pixels(width * height);
+    std::vector<uint8_t> row(width);
+    for (int j = 0; j < height; ++j)
+    {
+        if (magic == "P5")
+        {
+            if (j == 0)
+                in.get(); // single whitespace between header and raster
+            in.read(reinterpret_cast<char *>(row.data()), width);
+        }
+        else
+        {
+            for (int i = 0; i < width; ++i)
+                row[i] = static_cast<uint8_t>(std::stoi(nextToken()));
+        }
+        if (!in)
+            throw std::runtime_error(std::string("Truncated PGM raster: ") + filename);
+
+        // image rows run top to bottom, world y runs bottom to top
+        std::copy(row.begin(), row.end(), pixels.begin() + (height - 1 - j) * width);
+        if (maxValue != 255)
+        {
+            for (int i = 0; i < width; ++i)
+                pixels[(height - 1 - j) * width + i] = static_cast<uint8_t>(row[i] * 255 / maxValue);
+        }
+    }
+    return pixels;
+}
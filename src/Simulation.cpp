@@ -0,0 +1,498 @@
+#include "Simulation.h"
+#include "LongRangeForce.h"
+
+template <typename Real>
+BasicSimulationBase<Real>::BasicSimulationBase(float rad, float mas, float damp, float targetDens, float pressureMult, bool periodic, bool open)
+    : radius(rad), mass(mas), damping(damp), targetDensity(targetDens), pressureMultiplier(pressureMult), gravity(0.0f, -9.81f),
+      boundary{glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, 1.0f), periodic, periodic, nullptr},
+      periodicAllowed(periodic), unbounded(open), longRangeForce(nullptr), pool(nullptr),
+      placedParticles(nullptr), placedCount(0), graphItems(0),
+      predicted(nullptr), pressureAcceleration(nullptr), externalAcceleration(nullptr), stampCounter(0),
+      grid(boundary.domainMin, boundary.domainMax, rad), hash(rad)
+{
+    mouseFields.reserve(1);
+    grid.setPeriodic(periodic, periodic);
+}
+
+template <typename Real>
+void BasicSimulationBase<Real>::setBoundaryField(const SignedDistanceField *field)
+{
+    boundary.field = field;
+}
+
+template <typename Real>
+void BasicSimulationBase<Real>::setPeriodic(bool x, bool y)
+{
+    if (!periodicAllowed)
+        return;
+    boundary.periodicX = x;
+    boundary.periodicY = y;
+    grid.setPeriodic(x, y);
+}
+
+template <typename Real>
+void BasicSimulationBase<Real>::setThreadPool(ThreadPool *threadPool)
+{
+    pool = threadPool;
+    placedParticles = nullptr;
+}
+
+template <typename Real>
+void BasicSimulationBase<Real>::setLongRangeForce(LongRangeForce *force)
+{
+    longRangeForce = force;
+}
+
+template <typename Real>
+void BasicSimulationBase<Real>::updateParticles(std::vector<ParticleType> &particles, float deltaTime, glm::vec3 mouseVector)
+{
+    // the mouse is an attractor whose sign comes from the pressed button
+    mouseFields.clear();
+    if (mouseVector.z != 0.0f)
+        mouseFields.emplace_back(InteractionField::Type::Attractor, glm::vec2(mouseVector.x, mouseVector.y), 1.0f, mouseVector.z);
+    updateParticles(particles, deltaTime, mouseFields);
+}
+
+template <typename Real>
+void BasicSimulationBase<Real>::placeArrays(const std::vector<ParticleType> &particles)
+{
+    if (!pool || !pool->isNumaAware() || (particles.data() == placedParticles && particles.size() == placedCount))
+        return;
+    pool->placePages(particles.data(), particles.size() * sizeof(ParticleType));
+    if (unbounded)
+        hash.placePages(*pool);
+    else
+        grid.placePages(*pool);
+    placedParticles = particles.data();
+    placedCount = particles.size();
+}
+
+template <typename Real>
+void BasicSimulationBase<Real>::applyInteractionFields(std::vector<ParticleType> &particles, const std::vector<InteractionField> &fields, float deltaTime)
+{
+    externalAcceleration = arena.allocate<glm::vec2>(particles.size());
+    forEachStatic(particles.size(), [&](size_t i)
+                  { externalAcceleration[i] = glm::vec2(0.0f); });
+    fieldStamp.resize(particles.size(), 0);
+
+    // the grid holds predicted positions, pad the query by the furthest a clamped velocity can move
+    const float padding = maxParticleSpeed * deltaTime;
+
+    for (const auto &field : fields)
+    {
+        if (field.strength == 0.0f || field.radius <= 0.0f)
+            continue;
+        if (++stampCounter == 0)
+        {
+            std::fill(fieldStamp.begin(), fieldStamp.end(), 0);
+            stampCounter = 1;
+        }
+
+        auto visit = [&](uint32_t j)
+        {
+            if (fieldStamp[j] == stampCounter)
+                return;
+            fieldStamp[j] = stampCounter;
+
+            const glm::vec2 position(particles[j].position);
+            glm::vec2 toField = unbounded ? field.center - position : grid.offset(field.center, position);
+            float distance = glm::length(toField);
+            if (distance >= field.radius || distance <= 0.01f)
+                return;
+
+            float normalizedDist = distance / field.radius;
+            float falloff = (1.0f - normalizedDist * normalizedDist);
+            float accel = field.strength * 50.0f * falloff / (distance + 0.1f);
+            glm::vec2 direction = toField / distance;
+            switch (field.type)
+            {
+            case InteractionField::Type::Attractor:
+                externalAcceleration[j] += direction * accel;
+                break;
+            case InteractionField::Type::Repulsor:
+                externalAcceleration[j] -= direction * accel;
+                break;
+            case InteractionField::Type::Vortex:
+                externalAcceleration[j] += glm::vec2(direction.y, -direction.x) * accel;
+                break;
+            }
+        };
+
+        if (unbounded)
+            hash.forEachInRadius(field.center, field.radius + padding, visit);
+        else
+            grid.forEachInRadius(field.center, field.radius + padding, visit);
+    }
+}
+
+template class BasicSimulationBase<float>;
+template class BasicSimulationBase<double>;
+
+template <typename Kernel, typename Integrator, typename Boundary, typename Precision>
+BasicSimulation<Kernel, Integrator, Boundary, Precision>::BasicSimulation(float rad, float mas, float damp, float targetDens, float pressureMult, const Kernel &kernel)
+    : Base(rad, mas, damp, targetDens, pressureMult, Boundary::periodic, Boundary::unbounded), kernel(kernel),
+      stepParticles(nullptr), stepCount(0), stepDeltaTime(0), chunkStart(nullptr), anchorSize(rad), predictedCell(nullptr), predictedLocal(nullptr)
+{
+}
+
+template <typename Kernel, typename Integrator, typename Boundary, typename Precision>
+void BasicSimulation<Kernel, Integrator, Boundary, Precision>::anchor(size_t i, const AccumVec &position, const AccumVec &previous)
+{
+    anchorCell[i] = glm::ivec2(glm::floor(position / anchorSize));
+    const AccumVec origin = anchorOrigin(i);
+    anchorLocal[i] = Vec(position - origin);
+    anchorPrevious[i] = Vec(previous - origin);
+}
+
+template <typename Kernel, typename Integrator, typename Boundary, typename Precision>
+void BasicSimulation<Kernel, Integrator, Boundary, Precision>::anchorParticles(const std::vector<ParticleType> &particles)
+{
+    const size_t anchored = anchorCell.size();
+    anchorCell.resize(particles.size());
+    anchorLocal.resize(particles.size());
+    anchorPrevious.resize(particles.size());
+    this->forEachStatic(particles.size(), [&](size_t i)
+                        {
+        // integrate() exports exactly this rounding, anything else is an outside edit
+        const ParticleType &particle = particles[i];
+        if (i >= anchored || Vec(anchorOrigin(i) + AccumVec(anchorLocal[i])) != particle.position)
+            anchor(i, AccumVec(particle.position), AccumVec(particle.previous())); });
+}
+
+template <typename Kernel, typename Integrator, typename Boundary, typename Precision>
+size_t BasicSimulation<Kernel, Integrator, Boundary, Precision>::graphItemCount(size_t particleCount) const
+{
+    if constexpr (Boundary::unbounded)
+        return (particleCount + chunkParticles - 1) / chunkParticles;
+    const size_t workers = pool ? pool->size() : 1;
+    return std::min<size_t>(grid.getCellCount(), workers * chunksPerWorker);
+}
+
+template <typename Kernel, typename Integrator, typename Boundary, typename Precision>
+void BasicSimulation<Kernel, Integrator, Boundary, Precision>::buildGraph(size_t items)
+{
+    graph.clear();
+    graphItems = items;
+
+    const uint32_t densityPhase = graph.addPhase([this](uint32_t item)
+                                                 { forEachInItem(item, [this](size_t i)
+                                                                 { calculateDensity(i); }); });
+    const uint32_t pressurePhase = graph.addPhase([this](uint32_t item)
+                                                  { forEachInItem(item, [this](size_t i)
+                                                                  { calculatePressureForce(i); }); });
+    const uint32_t integratePhase = graph.addPhase([this](uint32_t item)
+                                                   { forEachInItem(item, [this](size_t i)
+                                                                   { integrate(i); }); });
+
+    // task ids are phase * items + item
+    for (uint32_t phase : {densityPhase, pressurePhase, integratePhase})
+    {
+        for (uint32_t item = 0; item < items; ++item)
+            graph.addTask(phase, item);
+    }
+
+    // grid chunks move every step, partitionCells links them: one edge into each integration task and at
+    // most one from every density task into each pressure task. Reserving that bound keeps relinking
+    // free of allocations however the chunks shift.
+    if constexpr (!Boundary::unbounded)
+        graph.reserveDependencies(items * (items + 1));
+    else
+    {
+        // hashed neighbors can come from any chunk: one join task stands in for a full barrier
+        const uint32_t count = static_cast<uint32_t>(items);
+        const uint32_t joinPhase = graph.addPhase([](uint32_t) {});
+        const uint32_t join = graph.addTask(joinPhase, 0);
+        for (uint32_t item = 0; item < count; ++item)
+        {
+            graph.addDependency(densityPhase * count + item, join);
+            graph.addDependency(join, pressurePhase * count + item);
+            graph.addDependency(pressurePhase * count + item, integratePhase * count + item);
+        }
+    }
+}
+
+template <typename Kernel, typename Integrator, typename Boundary, typename Precision>
+void BasicSimulation<Kernel, Integrator, Boundary, Precision>::partitionCells()
+{
+    const int cells = grid.getCellCount();
+    const uint32_t count = static_cast<uint32_t>(graphItems);
+    uint64_t *cost = arena.template allocate<uint64_t>(cells + 1);
+    grid.cellCosts(cost);
+
+    // cut the row-major cell order where the running cost crosses each equal share, so a crowded
+    // region gets many short chunks and empty space few long ones
+    chunkStart = arena.template allocate<int>(count + 1);
+    for (uint32_t item = 0; item < count; ++item)
+        chunkStart[item] = static_cast<int>(std::lower_bound(cost, cost + cells + 1, cost[cells] * item / count) - cost);
+    chunkStart[count] = cells;
+
+    // the 3x3 neighbors of a cell lie within cellsX + 1 cells of it in row-major order,
+    // or 2 * cellsX with a wrapped x axis; a wrapped y axis also wraps the range
+    const int reach = Boundary::periodic ? 2 * grid.getCellsX() : grid.getCellsX() + 1;
+    auto dependOn = [&](int lo, int hi, uint32_t after)
+    {
+        int first = static_cast<int>(std::upper_bound(chunkStart, chunkStart + count + 1, lo) - chunkStart) - 1;
+        for (int item = std::max(first, 0); item < static_cast<int>(count) && chunkStart[item] < hi; ++item)
+        {
+            if (chunkStart[item] < chunkStart[item + 1])
+                graph.addDependency(item, after);
+        }
+    };
+
+    graph.clearDependencies();
+    for (uint32_t item = 0; item < count; ++item)
+    {
+        const uint32_t pressure = count + item;
+        // integration moves only its own chunk's particles, which no other pressure task reads
+        graph.addDependency(pressure, 2 * count + item);
+        if (chunkStart[item] == chunkStart[item + 1])
+            continue;
+
+        const int lo = chunkStart[item] - reach;
+        const int hi = chunkStart[item + 1] + reach;
+        if (!Boundary::periodic)
+            dependOn(std::max(lo, 0), std::min(hi, cells), pressure);
+        else if (hi - lo >= cells)
+            dependOn(0, cells, pressure);
+        else
+        {
+            dependOn(std::max(lo, 0), std::min(hi, cells), pressure);
+            if (lo < 0)
+                dependOn(lo + cells, cells, pressure);
+            if (hi > cells)
+                dependOn(0, hi - cells, pressure);
+        }
+    }
+}
+
+template <typename Kernel, typename Integrator, typename Boundary, typename Precision>
+void BasicSimulation<Kernel, Integrator, Boundary, Precision>::updateParticles(std::vector<ParticleType> &particles, float deltaTime, const std::vector<InteractionField> &fields)
+{
+    // Clamp deltaTime to prevent instability
+    deltaTime = std::clamp(deltaTime, 0.001f, 0.033f);
+
+    // Calculate predicted positions first
+    predicted = arena.template allocate<Vec>(particles.size());
+    pressureAcceleration = arena.template allocate<Vec>(particles.size());
+    if constexpr (Precision::cellRelative)
+    {
+        // integration moves the anchors while other chunks still read neighbor offsets,
+        // so the predicted positions get cells of their own
+        anchorParticles(particles);
+        predictedCell = arena.template allocate<glm::ivec2>(particles.size());
+        predictedLocal = arena.template allocate<Vec>(particles.size());
+        this->forEachStatic(particles.size(), [&](size_t i)
+                            {
+            const AccumVec origin = anchorOrigin(i);
+            const WideParticle wide{origin + AccumVec(anchorLocal[i]), AccumVec(particles[i].velocity), origin + AccumVec(anchorPrevious[i])};
+            const AccumVec position = Integrator::predict(wide, Accum(deltaTime));
+            predictedCell[i] = glm::ivec2(glm::floor(position / anchorSize));
+            predictedLocal[i] = Vec(position - AccumVec(predictedCell[i]) * anchorSize);
+            predicted[i] = Vec(position); });
+    }
+    else
+    {
+        this->forEachStatic(particles.size(), [&](size_t i)
+                            { predicted[i] = Integrator::predict(particles[i], Real(deltaTime)); });
+    }
+
+    if constexpr (Boundary::unbounded)
+        hash.build(predicted, particles.size());
+    else
+        grid.build(predicted, particles.size());
+    this->placeArrays(particles);
+
+    // both read the current positions, so they run before any block integrates
+    if (longRangeForce)
+        longRangeForce->compute(particles, mass);
+    this->applyInteractionFields(particles, fields, deltaTime);
+
+    const size_t items = graphItemCount(particles.size());
+    if (items != graphItems)
+        buildGraph(items);
+    if constexpr (!Boundary::unbounded)
+        partitionCells();
+    stepParticles = particles.data();
+    stepCount = particles.size();
+    stepDeltaTime = Accum(deltaTime);
+    graph.run(pool);
+    stepParticles = nullptr;
+
+    arena.reset();
+}
+
+template <typename Kernel, typename Integrator, typename Boundary, typename Precision>
+void BasicSimulation<Kernel, Integrator, Boundary, Precision>::integrate(size_t i)
+{
+    ParticleType &particle = stepParticles[i];
+
+    // Calculate acceleration including interaction (mouse) forces, applied BEFORE integration
+    AccumVec acceleration = AccumVec(pressureAcceleration[i]) + AccumVec(gravity) + AccumVec(externalAcceleration[i]);
+    if (longRangeForce)
+        acceleration += AccumVec(longRangeForce->getAccelerations()[i]);
+
+    if constexpr (Precision::cellRelative)
+    {
+        const AccumVec origin = anchorOrigin(i);
+        WideParticle wide{origin + AccumVec(anchorLocal[i]), AccumVec(particle.velocity), origin + AccumVec(anchorPrevious[i])};
+        Integrator::integrate(wide, acceleration, stepDeltaTime, Accum(damping));
+        Boundary::apply(wide, boundary);
+        anchor(i, wide.position, wide.previousPosition);
+
+        const AccumVec moved = anchorOrigin(i);
+        particle.velocity = Vec(wide.velocity);
+        particle.position = Vec(moved + AccumVec(anchorLocal[i]));
+        particle.setPrevious(Vec(moved + AccumVec(anchorPrevious[i])));
+    }
+    else
+    {
+        Integrator::integrate(particle, acceleration, stepDeltaTime, Accum(damping));
+        Boundary::apply(particle, boundary);
+    }
+}
+
+// precomputes the density
+template <typename Kernel, typename Integrator, typename Boundary, typename Precision>
+void BasicSimulation<Kernel, Integrator, Boundary, Precision>::calculateDensity(size_t i)
+{
+    const ParticleType *particles = stepParticles;
+    ParticleType &particle = stepParticles[i];
+    Accum density = 0;
+    forEachNeighbor(i, [&](uint32_t j, const Vec &distVector)
+    {
+        // cells are sized for the largest smoothing length, so every pair length fits the query
+        Accum scaleCheck = particles[j].sizeScale;
+        Accum h = Accum(0.5f * radius) * (Accum(particle.sizeScale) + scaleCheck);
+        AccumVec offset(distVector);
+        Accum distanceSq = glm::dot(offset, offset);
+        if (distanceSq > h * h)
+            return;
+
+        Accum influence = kernel.value(distanceSq, h);
+        density += influence * Accum(mass) * scaleCheck * scaleCheck;
+    });
+    particle.density = Real(density);
+}
+
+// calculating the pressure gradient
+template <typename Kernel, typename Integrator, typename Boundary, typename Precision>
+void BasicSimulation<Kernel, Integrator, Boundary, Precision>::calculatePressureForce(size_t i)
+{
+    const ParticleType *particles = stepParticles;
+    const ParticleType &particle = stepParticles[i];
+    AccumVec pressureForce = AccumVec(0);
+    const Accum density = particle.density;
+    const Accum pressure_i = std::max((density - Accum(targetDensity)) * Accum(pressureMultiplier), Accum(0));
+
+    forEachNeighbor(i, [&](uint32_t j, const Vec &distVector)
+    {
+        const ParticleType &particleCheck = particles[j];
+        Accum h = Accum(0.5f * radius) * (Accum(particle.sizeScale) + Accum(particleCheck.sizeScale));
+        AccumVec offset(distVector);
+        Accum distance = glm::length(offset);
+
+        if (distance > h || j == i)
+            return;
+
+        AccumVec direction = offset / distance;
+        Accum influence = kernel.gradient(distance, h);
+        Accum massCheck = Accum(mass) * Accum(particleCheck.sizeScale) * Accum(particleCheck.sizeScale);
+
+        Accum densityCheck = particleCheck.density;
+        Accum pressure_j = std::max((densityCheck - Accum(targetDensity)) * Accum(pressureMultiplier), Accum(0));
+        Accum pressureTerm = (pressure_i / (density * density) + pressure_j / (densityCheck * densityCheck));
+        pressureForce += -direction * (massCheck * pressureTerm * influence);
+    });
+    pressureAcceleration[i] = Vec(pressureForce / density);
+}
+
+// Every combination is compiled here so users and the factory only need the header
+#define INSTANTIATE_BOUNDARIES(K, I, P)                        \
+    template class BasicSimulation<K, I, BoxBoundary, P>;      \
+    template class BasicSimulation<K, I, PeriodicBoundary, P>; \
+    template class BasicSimulation<K, I, SdfBoundary, P>;      \
+    template class BasicSimulation<K, I, OpenBoundary, P>;
+
+#define INSTANTIATE_INTEGRATORS(K, P)                          \
+    INSTANTIATE_BOUNDARIES(K, VerletIntegrator, P)             \
+    INSTANTIATE_BOUNDARIES(K, LeapfrogIntegrator, P)           \
+    INSTANTIATE_BOUNDARIES(K, SymplecticEulerIntegrator, P)
+
+#define INSTANTIATE_KERNELS(P)                                 \
+    INSTANTIATE_INTEGRATORS(Poly6SpikyKernel, P)               \
+    INSTANTIATE_INTEGRATORS(CubicSplineKernel, P)              \
+    INSTANTIATE_INTEGRATORS(WendlandC2Kernel, P)               \
+    INSTANTIATE_INTEGRATORS(TabulatedKernel, P)
+
+INSTANTIATE_KERNELS(SinglePrecision)
+INSTANTIATE_KERNELS(MixedPrecision)
+INSTANTIATE_KERNELS(DoublePrecision)
+
+#undef INSTANTIATE_KERNELS
+#undef INSTANTIATE_INTEGRATORS
+#undef INSTANTIATE_BOUNDARIES
+
+namespace
+{
+    template <typename Precision, typename Kernel, typename Integrator>
+    std::unique_ptr<BasicSimulationBase<typename Precision::Storage>> makeWithBoundary(BoundaryType boundary, float rad, float mas, float damp, float targetDens, float pressureMult, const Kernel &kernel)
+    {
+        switch (boundary)
+        {
+        case BoundaryType::Box:
+            return std::make_unique<BasicSimulation<Kernel, Integrator, BoxBoundary, Precision>>(rad, mas, damp, targetDens, pressureMult, kernel);
+        case BoundaryType::Periodic:
+            return std::make_unique<BasicSimulation<Kernel, Integrator, PeriodicBoundary, Precision>>(rad, mas, damp, targetDens, pressureMult, kernel);
+        case BoundaryType::SDF:
+            return std::make_unique<BasicSimulation<Kernel, Integrator, SdfBoundary, Precision>>(rad, mas, damp, targetDens, pressureMult, kernel);
+        case BoundaryType::Open:
+            return std::make_unique<BasicSimulation<Kernel, Integrator, OpenBoundary, Precision>>(rad, mas, damp, targetDens, pressureMult, kernel);
+        }
+        return nullptr;
+    }
+
+    template <typename Precision, typename Kernel>
+    std::unique_ptr<BasicSimulationBase<typename Precision::Storage>> makeWithIntegrator(IntegratorType integrator, BoundaryType boundary, float rad, float mas, float damp, float targetDens, float pressureMult, const Kernel &kernel)
+    {
+        switch (integrator)
+        {
+        case IntegratorType::Verlet:
+            return makeWithBoundary<Precision, Kernel, VerletIntegrator>(boundary, rad, mas, damp, targetDens, pressureMult, kernel);
+        case IntegratorType::Leapfrog:
+            return makeWithBoundary<Precision, Kernel, LeapfrogIntegrator>(boundary, rad, mas, damp, targetDens, pressureMult, kernel);
+        case IntegratorType::SymplecticEuler:
+            return makeWithBoundary<Precision, Kernel, SymplecticEulerIntegrator>(boundary, rad, mas, damp, targetDens, pressureMult, kernel);
+        }
+        return nullptr;
+    }
+}
+
+template <typename Precision>
+std::unique_ptr<BasicSimulationBase<typename Precision::Storage>> makeSimulation(KernelType kernel, IntegratorType integrator, BoundaryType boundary,
+                                                                                  float rad, float mas, float damp, float targetDens, float pressureMult,
+                                                                                  KernelShape tableShape)
+{
+    switch (kernel)
+    {
+    case KernelType::Poly6Spiky:
+        return makeWithIntegrator<Precision>(integrator, boundary, rad, mas, damp, targetDens, pressureMult, Poly6SpikyKernel());
+    case KernelType::CubicSpline:
+        return makeWithIntegrator<Precision>(integrator, boundary, rad, mas, damp, targetDens, pressureMult, CubicSplineKernel());
+    case KernelType::WendlandC2:
+        return makeWithIntegrator<Precision>(integrator, boundary, rad, mas, damp, targetDens, pressureMult, WendlandC2Kernel());
+    case KernelType::Tabulated:
+        return makeWithIntegrator<Precision>(integrator, boundary, rad, mas, damp, targetDens, pressureMult, TabulatedKernel(tableShape));
+    }
+    return nullptr;
+}
+
+template std::unique_ptr<SimulationBase> makeSimulation<SinglePrecision>(KernelType, IntegratorType, BoundaryType, float, float, float, float, float, KernelShape);
+template std::unique_ptr<SimulationBase> makeSimulation<MixedPrecision>(KernelType, IntegratorType, BoundaryType, float, float, float, float, float, KernelShape);
+template std::unique_ptr<SimulationBaseD> makeSimulation<DoublePrecision>(KernelType, IntegratorType, BoundaryType, float, float, float, float, float, KernelShape);
+
+std::unique_ptr<SimulationBase> makeSimulation(KernelType kernel, IntegratorType integrator, BoundaryType boundary,
+                                               float rad, float mas, float damp, float targetDens, float pressureMult,
+                                               KernelShape tableShape)
+{
+    return makeSimulation<SinglePrecision>(kernel, integrator, boundary, rad, mas, damp, targetDens, pressureMult, tableShape);
+}
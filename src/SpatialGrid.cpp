@@ -0,0 +1,125 @@
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+
+#include <stdexcept>
+
+SpatialGrid::SpatialGrid(glm::vec2 minCorner, glm::vec2 maxCorner, float minCellSize)
+    : minCorner(minCorner), extent(maxCorner - minCorner), periodicX(false), periodicY(false)
+{
+    // cell indices are ints; a cell size far below the domain (or zero) would overflow them
+    const double columns = std::floor(double(extent.x) / minCellSize);
+    const double rows = std::floor(double(extent.y) / minCellSize);
+    if (!(columns * rows <= maxCells))
+        throw std::runtime_error("Spatial grid cell size is too small for the domain");
+    cellsX = std::max(1, static_cast<int>(columns));
+    cellsY = std::max(1, static_cast<int>(rows));
+    cellSize = glm::vec2(extent.x / cellsX, extent.y / cellsY);
+    cellStart.assign(cellsX * cellsY + 1, 0);
+}
+
+void SpatialGrid::setPeriodic(bool x, bool y)
+{
+    periodicX = x;
+    periodicY = y;
+}
+
+int SpatialGrid::wrapCell(int c, int cells, bool periodic) const
+{
+    if (periodic)
+        return ((c % cells) + cells) % cells;
+    // particles slightly outside the box share the border cell, which keeps neighbors within one cell
+    return std::clamp(c, 0, cells - 1);
+}
+
+int SpatialGrid::neighborCells(int c, int cells, bool periodic, int out[3]) const
+{
+    c = wrapCell(c, cells, periodic);
+    if (periodic && cells < 3)
+    {
+        // every cell is a neighbor, list each once so nobody is visited twice through the wrap
+        for (int i = 0; i < cells; ++i)
+            out[i] = i;
+        return cells;
+    }
+
+    int count = 0;
+    for (int d = -1; d <= 1; ++d)
+    {
+        int n = c + d;
+        if (periodic)
+            n = wrapCell(n, cells, true);
+        else if (n < 0 || n >= cells)
+            continue;
+        out[count++] = n;
+    }
+    return count;
+}
+
+template <typename Real>
+void SpatialGrid::build(const glm::vec<2, Real> *positions, size_t count)
+{
+    particleCell.resize(count);
+    sortedIndices.resize(count);
+    sortedPositions.resize(count);
+    std::fill(cellStart.begin(), cellStart.end(), 0);
+
+    // counting sort: histogram, exclusive prefix sum, scatter
+    for (size_t i = 0; i < count; ++i)
+    {
+        const glm::vec2 pos(positions[i]);
+        int cx = wrapCell(static_cast<int>(std::floor((pos.x - minCorner.x) / cellSize.x)), cellsX, periodicX);
+        int cy = wrapCell(static_cast<int>(std::floor((pos.y - minCorner.y) / cellSize.y)), cellsY, periodicY);
+        particleCell[i] = cy * cellsX + cx;
+        ++cellStart[particleCell[i] + 1];
+    }
+    for (size_t c = 1; c < cellStart.size(); ++c)
+        cellStart[c] += cellStart[c - 1];
+
+    // scatter with a moving cursor per cell, then restore the start offsets
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t slot = cellStart[particleCell[i]]++;
+        sortedIndices[slot] = static_cast<uint32_t>(i);
+        sortedPositions[slot] = glm::vec2(positions[i]);
+    }
+    for (size_t c = cellStart.size() - 1; c > 0; --c)
+        cellStart[c] = cellStart[c - 1];
+    cellStart[0] = 0;
+}
+
+void SpatialGrid::cellCosts(uint64_t *prefix) const
+{
+    prefix[0] = 0;
+    for (int cy = 0; cy < cellsY; ++cy)
+    {
+        int ys[3];
+        int countY = neighborCells(cy, cellsY, periodicY, ys);
+        for (int cx = 0; cx < cellsX; ++cx)
+        {
+            int xs[3];
+            int countX = neighborCells(cx, cellsX, periodicX, xs);
+            uint64_t around = 0;
+            for (int b = 0; b < countY; ++b)
+            {
+                for (int a = 0; a < countX; ++a)
+                {
+                    int cell = ys[b] * cellsX + xs[a];
+                    around += cellStart[cell + 1] - cellStart[cell];
+                }
+            }
+            int cell = cy * cellsX + cx;
+            prefix[cell + 1] = prefix[cell] + around * (cellStart[cell + 1] - cellStart[cell]);
+        }
+    }
+}
+
+template void SpatialGrid::build(const glm::vec2 *positions, size_t count);
+template void SpatialGrid::build(const glm::dvec2 *positions, size_t count);
+
+void SpatialGrid::placePages(const ThreadPool &pool) const
+{
+    pool.placePages(cellStart.data(), cellStart.size() * sizeof(cellStart[0]));
+    pool.placePages(particleCell.data(), particleCell.size() * sizeof(particleCell[0]));
+    pool.placePages(sortedIndices.data(), sortedIndices.size() * sizeof(sortedIndices[0]));
+    pool.placePages(sortedPositions.data(), sortedPositions.size() * sizeof(sortedPositions[0]));
+}
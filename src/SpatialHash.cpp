@@ -0,0 +1,58 @@
+#include "SpatialHash.h"
+#include "ThreadPool.h"
+
+SpatialHash::SpatialHash(float cellSize)
+    : cellSize(cellSize), tableMask(0)
+{
+    bucketStart.assign(2, 0);
+}
+
+template <typename Real>
+void SpatialHash::build(const glm::vec<2, Real> *positions, size_t count)
+{
+    // about two buckets per particle keeps collisions rare without tying memory to the domain size
+    size_t tableSize = 1;
+    while (tableSize < 2 * count)
+        tableSize <<= 1;
+    if (tableSize > tableMask + 1)
+    {
+        tableMask = static_cast<uint32_t>(tableSize - 1);
+        bucketStart.resize(tableSize + 1);
+    }
+
+    particleBucket.resize(count);
+    sortedIndices.resize(count);
+    sortedPositions.resize(count);
+    std::fill(bucketStart.begin(), bucketStart.end(), 0);
+
+    // counting sort: histogram, exclusive prefix sum, scatter
+    for (size_t i = 0; i < count; ++i)
+    {
+        const glm::vec2 pos(positions[i]);
+        particleBucket[i] = bucketOf(cellCoordinate(pos.x), cellCoordinate(pos.y));
+        ++bucketStart[particleBucket[i] + 1];
+    }
+    for (size_t b = 1; b < bucketStart.size(); ++b)
+        bucketStart[b] += bucketStart[b - 1];
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t slot = bucketStart[particleBucket[i]]++;
+        sortedIndices[slot] = static_cast<uint32_t>(i);
+        sortedPositions[slot] = glm::vec2(positions[i]);
+    }
+    for (size_t b = bucketStart.size() - 1; b > 0; --b)
+        bucketStart[b] = bucketStart[b - 1];
+    bucketStart[0] = 0;
+}
+
+template void SpatialHash::build(const glm::vec2 *positions, size_t count);
+template void SpatialHash::build(const glm::dvec2 *positions, size_t count);
+
+void SpatialHash::placePages(const ThreadPool &pool) const
+{
+    pool.placePages(bucketStart.data(), bucketStart.size() * sizeof(bucketStart[0]));
+    pool.placePages(particleBucket.data(), particleBucket.size() * sizeof(particleBucket[0]));
+    pool.placePages(sortedIndices.data(), sortedIndices.size() * sizeof(sortedIndices[0]));
+    pool.placePages(sortedPositions.data(), sortedPositions.size() * sizeof(sortedPositions[0]));
+}
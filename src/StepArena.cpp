@@ -0,0 +1,61 @@
+#include "StepArena.h"
+
+StepArena::StepArena(size_t initialBytes)
+    : current(0), offset(0), stats{0, 0, 0, 0}
+{
+    blocks.reserve(8);
+    addBlock(initialBytes);
+}
+
+void StepArena::addBlock(size_t minimumBytes)
+{
+    // at least double the last block so a growing step needs few chained blocks
+    size_t size = blocks.empty() ? minimumBytes : std::max(minimumBytes, 2 * blocks.back().size);
+    Block block;
+    block.memory.reset(new unsigned char[size]);
+    block.size = size;
+    blocks.push_back(std::move(block));
+    stats.capacity += size;
+    ++stats.heapAllocations;
+}
+
+void *StepArena::allocateBytes(size_t bytes, size_t alignment)
+{
+    for (;;)
+    {
+        Block &block = blocks[current];
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.memory.get());
+        uintptr_t aligned = (base + offset + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+        size_t end = static_cast<size_t>(aligned - base) + bytes;
+        if (end <= block.size)
+        {
+            stats.used += end - offset;
+            offset = end;
+            return reinterpret_cast<void *>(aligned);
+        }
+
+        // the rest of this block is wasted for this step, the next reset() reclaims it
+        stats.used += block.size - offset;
+        if (current + 1 == blocks.size())
+            addBlock(bytes + alignment);
+        ++current;
+        offset = 0;
+    }
+}
+
+void StepArena::reset()
+{
+    stats.highWater = std::max(stats.highWater, stats.used);
+
+    if (blocks.size() > 1)
+    {
+        // fold the chain into one block big enough for the whole step
+        size_t total = stats.capacity;
+        blocks.clear();
+        stats.capacity = 0;
+        addBlock(total);
+    }
+    current = 0;
+    offset = 0;
+    stats.used = 0;
+}
@@ -0,0 +1,176 @@
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <thread>
+
+TaskGraph::TaskGraph()
+    : pendingCapacity(0), queueCount(0), queuePool(nullptr), dirty(false), remaining(0), steals(0)
+{
+}
+
+void TaskGraph::clear()
+{
+    phases.clear();
+    tasks.clear();
+    edges.clear();
+    dirty = true;
+}
+
+uint32_t TaskGraph::addPhase(std::function<void(uint32_t item)> body)
+{
+    phases.push_back(std::move(body));
+    return static_cast<uint32_t>(phases.size() - 1);
+}
+
+uint32_t TaskGraph::addTask(uint32_t phase, uint32_t item)
+{
+    tasks.push_back(Task{phase, item, 0});
+    dirty = true;
+    return static_cast<uint32_t>(tasks.size() - 1);
+}
+
+void TaskGraph::addDependency(uint32_t before, uint32_t after)
+{
+    edges.push_back((static_cast<uint64_t>(before) << 32) | after);
+    dirty = true;
+}
+
+void TaskGraph::clearDependencies()
+{
+    edges.clear();
+    dirty = true;
+}
+
+void TaskGraph::reserveDependencies(size_t count)
+{
+    edges.reserve(count);
+    successors.reserve(count);
+}
+
+void TaskGraph::finalize()
+{
+    // duplicate edges would only count twice, drop them anyway
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    successorStart.assign(tasks.size() + 1, 0);
+    for (auto &task : tasks)
+        task.dependencies = 0;
+    for (uint64_t edge : edges)
+    {
+        ++successorStart[(edge >> 32) + 1];
+        ++tasks[static_cast<uint32_t>(edge)].dependencies;
+    }
+    for (size_t t = 1; t < successorStart.size(); ++t)
+        successorStart[t] += successorStart[t - 1];
+
+    // edges are sorted by their first task, so successors come out grouped already
+    successors.resize(edges.size());
+    for (size_t e = 0; e < edges.size(); ++e)
+        successors[e] = static_cast<uint32_t>(edges[e]);
+
+    if (tasks.size() > pendingCapacity)
+    {
+        pending.reset(new std::atomic<uint32_t>[tasks.size()]);
+        pendingCapacity = tasks.size();
+    }
+    dirty = false;
+}
+
+bool TaskGraph::steal(unsigned worker, uint32_t &task)
+{
+    const unsigned *order = victims.data() + worker * (queueCount - 1);
+    for (unsigned k = 0; k + 1 < queueCount; ++k)
+    {
+        if (queues[order[k]].steal(task))
+        {
+            steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskGraph::execute(unsigned worker, uint32_t task)
+{
+    const Task &current = tasks[task];
+    phases[current.phase](current.item);
+
+    // the last finished dependency releases a successor onto this worker's queue
+    for (uint32_t s = successorStart[task]; s < successorStart[task + 1]; ++s)
+    {
+        if (pending[successors[s]].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            queues[worker].push(successors[s]);
+    }
+    remaining.fetch_sub(1, std::memory_order_release);
+}
+
+void TaskGraph::workerLoop(unsigned worker)
+{
+    uint32_t task;
+    while (remaining.load(std::memory_order_acquire) > 0)
+    {
+        if (queues[worker].pop(task) || steal(worker, task))
+            execute(worker, task);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void TaskGraph::run(ThreadPool *pool)
+{
+    if (tasks.empty())
+        return;
+    if (dirty)
+        finalize();
+
+    const unsigned workers = pool ? pool->size() : 1;
+    if (workers != queueCount || pool != queuePool)
+    {
+        if (workers != queueCount)
+            queues.reset(new WorkStealingDeque[workers]);
+        queueCount = workers;
+        queuePool = pool;
+
+        // nearest first around the ring, and within that the own node before remote ones
+        victims.clear();
+        for (unsigned w = 0; w < workers; ++w)
+        {
+            const size_t first = victims.size();
+            for (unsigned k = 1; k < workers; ++k)
+                victims.push_back((w + k) % workers);
+            std::stable_partition(victims.begin() + first, victims.end(), [&](unsigned v)
+                                  { return pool->getThreadNode(v) == pool->getThreadNode(w); });
+        }
+    }
+    // each task is pushed once per run, so no deque ever holds more than the task count
+    for (unsigned w = 0; w < workers; ++w)
+        queues[w].reset(tasks.size());
+
+    // hand the roots out in contiguous runs, so neighboring items (and with a NUMA-aware pool, roughly
+    // one socket's share of the cell-ordered grid arrays) start on the same worker; the rest is released
+    // by its last dependency
+    size_t roots = 0;
+    for (uint32_t t = 0; t < tasks.size(); ++t)
+        roots += tasks[t].dependencies == 0;
+    size_t seeded = 0;
+    for (uint32_t t = 0; t < tasks.size(); ++t)
+    {
+        pending[t].store(tasks[t].dependencies, std::memory_order_relaxed);
+        if (tasks[t].dependencies == 0)
+            queues[seeded++ * workers / roots].push(t);
+    }
+    remaining.store(tasks.size(), std::memory_order_release);
+
+    if (workers == 1)
+    {
+        workerLoop(0);
+        return;
+    }
+    // one worker per pool thread, so worker w always runs where the pool pinned thread w
+    pool->parallelForStatic(0, workers, [this](size_t begin, size_t end)
+    {
+        for (size_t w = begin; w < end; ++w)
+            workerLoop(static_cast<unsigned>(w));
+    });
+}
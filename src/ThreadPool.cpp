@@ -0,0 +1,168 @@
+#include "ThreadPool.h"
+#include "Numa.h"
+
+#include <algorithm>
+
+namespace
+{
+    // pinned threads of the NUMA-aware pools alive right now, where the next pool starts
+    std::atomic<unsigned> pinnedThreads(0);
+
+    // read before the first pool pins anything, a later pool's constructing thread may already be pinned
+    const numa::Topology &processTopology()
+    {
+        static const numa::Topology topology = numa::topology();
+        return topology;
+    }
+}
+
+ThreadPool::ThreadPool(unsigned threadCount, bool numaAware)
+    : numaAware(numaAware), job(nullptr), jobBegin(0), jobEnd(0), grain(1), staticSchedule(false),
+      next(0), busyWorkers(0), generation(0), stopping(false)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    threadNode.assign(threadCount, 0);
+    nodeIds.assign(1, 0);
+    if (numaAware)
+    {
+        const numa::Topology &topology = processTopology();
+        if (!topology.cpus.empty())
+        {
+            // CPUs come grouped by node, so consecutive threads fill one socket before the next
+            const unsigned firstCpu = pinnedThreads.fetch_add(threadCount);
+            threadCpu.resize(threadCount);
+            for (unsigned t = 0; t < threadCount; ++t)
+            {
+                const size_t cpu = (firstCpu + t) % topology.cpus.size();
+                threadCpu[t] = topology.cpus[cpu];
+                threadNode[t] = topology.cpuNode[cpu];
+            }
+            nodeIds = topology.nodeIds;
+            callerCpus = numa::currentThreadCpus();
+            numa::pinCurrentThread(threadCpu[0]);
+        }
+    }
+
+    for (unsigned i = 1; i < threadCount; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers)
+        worker.join();
+
+    if (!threadCpu.empty())
+    {
+        numa::setCurrentThreadCpus(callerCpus);
+        pinnedThreads.fetch_sub(static_cast<unsigned>(threadCpu.size()));
+    }
+}
+
+void ThreadPool::runChunks(unsigned index)
+{
+    if (staticSchedule)
+    {
+        const size_t count = jobEnd - jobBegin;
+        const size_t chunkBegin = jobBegin + count * index / size();
+        const size_t chunkEnd = jobBegin + count * (index + 1) / size();
+        if (chunkBegin < chunkEnd)
+            (*job)(chunkBegin, chunkEnd);
+        return;
+    }
+
+    for (;;)
+    {
+        size_t chunkBegin = next.fetch_add(grain);
+        if (chunkBegin >= jobEnd)
+            return;
+        (*job)(chunkBegin, std::min(chunkBegin + grain, jobEnd));
+    }
+}
+
+void ThreadPool::workerLoop(unsigned index)
+{
+    if (!threadCpu.empty())
+        numa::pinCurrentThread(threadCpu[index]);
+
+    uint64_t seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]
+                      { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+
+        runChunks(index);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busyWorkers == 0)
+            finished.notify_one();
+    }
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, const std::function<void(size_t, size_t)> &body)
+{
+    dispatch(begin, end, body, false);
+}
+
+void ThreadPool::parallelForStatic(size_t begin, size_t end, const std::function<void(size_t, size_t)> &body)
+{
+    dispatch(begin, end, body, true);
+}
+
+void ThreadPool::placePages(const void *data, size_t bytes) const
+{
+    if (nodeIds.size() < 2)
+        return;
+    const char *base = static_cast<const char *>(data);
+    for (unsigned t = 0; t < size(); ++t)
+    {
+        const size_t first = bytes * t / size();
+        const size_t last = bytes * (t + 1) / size();
+        numa::movePages(base + first, last - first, nodeIds[threadNode[t]]);
+    }
+}
+
+void ThreadPool::dispatch(size_t begin, size_t end, const std::function<void(size_t, size_t)> &body, bool isStatic)
+{
+    if (begin >= end)
+        return;
+    if (workers.empty())
+    {
+        body(begin, end);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &body;
+        jobBegin = begin;
+        jobEnd = end;
+        staticSchedule = isStatic;
+        // a few chunks per thread evens out uneven rows without much counter traffic
+        grain = std::max<size_t>(1, (end - begin) / (size() * 4));
+        next.store(begin);
+        busyWorkers = workers.size();
+        ++generation;
+    }
+    wake.notify_all();
+
+    runChunks(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&]
+                  { return busyWorkers == 0; });
+    job = nullptr;
+}
@@ -0,0 +1,544 @@
+#include "TrajectoryCodec.h"
+
+#include "TrajectoryWriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    constexpr uint32_t keyframeFlag = 1;
+    constexpr int symbolCount = 33; // residual bit lengths 0..32
+    constexpr int maxCodeLength = 24;
+    // quantized values stay within +-2^24 steps of the keyframe's minimum, so residuals fit in 27 bits
+    constexpr int32_t quantizedLimit = 1 << 24;
+    constexpr float minimumRange = 1e-6f;
+    constexpr size_t frameHeaderBytes = 16;
+
+    std::vector<TrajectoryChannel> makeChannels(uint32_t fields)
+    {
+        std::vector<TrajectoryChannel> channels;
+        size_t base = 0;
+        auto add = [&](uint32_t field, size_t components)
+        {
+            if (!(fields & field))
+                return;
+            for (size_t c = 0; c < components; ++c)
+                channels.push_back(TrajectoryChannel{base, c, components, field, 0.0f, 1.0f, {}, {}, {}});
+            base += components;
+        };
+        add(TrajectoryPositions, 2);
+        add(TrajectoryVelocities, 2);
+        add(TrajectoryDensities, 1);
+        return channels;
+    }
+
+    inline const float &valueOf(const TrajectoryChannel &channel, const float *frame, size_t count, size_t particle)
+    {
+        return frame[channel.base * count + particle * channel.stride + channel.component];
+    }
+
+    inline float &valueOf(const TrajectoryChannel &channel, float *frame, size_t count, size_t particle)
+    {
+        return frame[channel.base * count + particle * channel.stride + channel.component];
+    }
+
+    inline int32_t clampQuantized(int64_t value)
+    {
+        return static_cast<int32_t>(std::min<int64_t>(std::max<int64_t>(value, -quantizedLimit), quantizedLimit));
+    }
+
+    // Constant velocity guess from the last two frames, the previous particle in a keyframe
+    inline int32_t predict(const TrajectoryChannel &channel, size_t i, uint32_t framesSinceKeyframe)
+    {
+        if (framesSinceKeyframe == 0)
+            return i > 0 ? channel.current[i - 1] : 0;
+        if (framesSinceKeyframe == 1)
+            return channel.previous[i];
+        return clampQuantized(2 * int64_t(channel.previous[i]) - channel.beforePrevious[i]);
+    }
+
+    inline uint32_t zigzag(int32_t value)
+    {
+        return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+    }
+
+    inline int32_t unzigzag(uint32_t value)
+    {
+        return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+    }
+
+    inline int bitLength(uint32_t value)
+    {
+        int length = 0;
+        while (value != 0)
+        {
+            ++length;
+            value >>= 1;
+        }
+        return length;
+    }
+
+    // Huffman code lengths; counts are halved until the longest code fits maxCodeLength
+    void buildCodeLengths(const uint64_t *counts, uint8_t *lengths)
+    {
+        std::vector<uint64_t> weights(counts, counts + symbolCount);
+        for (;;)
+        {
+            std::vector<int> parent(2 * symbolCount, -1);
+            typedef std::pair<uint64_t, int> Node;
+            std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+            for (int s = 0; s < symbolCount; ++s)
+            {
+                if (weights[s] > 0)
+                    queue.push(Node(weights[s], s));
+            }
+
+            std::fill(lengths, lengths + symbolCount, 0);
+            if (queue.size() == 1)
+                lengths[queue.top().second] = 1;
+            if (queue.size() <= 1)
+                return;
+
+            int next = symbolCount;
+            while (queue.size() > 1)
+            {
+                Node a = queue.top();
+                queue.pop();
+                Node b = queue.top();
+                queue.pop();
+                parent[a.second] = next;
+                parent[b.second] = next;
+                queue.push(Node(a.first + b.first, next++));
+            }
+
+            int longest = 0;
+            for (int s = 0; s < symbolCount; ++s)
+            {
+                if (weights[s] == 0)
+                    continue;
+                int depth = 0;
+                for (int node = s; parent[node] >= 0; node = parent[node])
+                    ++depth;
+                lengths[s] = static_cast<uint8_t>(depth);
+                longest = std::max(longest, depth);
+            }
+            if (longest <= maxCodeLength)
+                return;
+            for (uint64_t &weight : weights)
+            {
+                if (weight > 0)
+                    weight = (weight + 1) / 2;
+            }
+        }
+    }
+
+    // Canonical codes as in DEFLATE: shorter codes first, ties by symbol
+    struct CanonicalCode
+    {
+        uint32_t codes[symbolCount];
+        uint32_t first[maxCodeLength + 1];
+        uint32_t count[maxCodeLength + 1];
+        uint32_t offset[maxCodeLength + 1];
+        uint8_t sorted[symbolCount];
+
+        // False if the lengths do not form a prefix code
+        bool build(const uint8_t *lengths)
+        {
+            std::fill(count, count + maxCodeLength + 1, 0);
+            for (int s = 0; s < symbolCount; ++s)
+            {
+                if (lengths[s] > maxCodeLength)
+                    return false;
+                ++count[lengths[s]];
+            }
+            count[0] = 0;
+
+            uint64_t kraft = 0;
+            uint32_t code = 0;
+            uint32_t index = 0;
+            for (int length = 1; length <= maxCodeLength; ++length)
+            {
+                code = (code + (length > 1 ? count[length - 1] : 0)) << 1;
+                first[length] = code;
+                offset[length] = index;
+                index += count[length];
+                kraft += uint64_t(count[length]) << (maxCodeLength - length);
+            }
+            if (kraft > (uint64_t(1) << maxCodeLength))
+                return false;
+
+            uint32_t next[maxCodeLength + 1];
+            uint32_t slot[maxCodeLength + 1];
+            std::copy(first, first + maxCodeLength + 1, next);
+            std::copy(offset, offset + maxCodeLength + 1, slot);
+            for (int s = 0; s < symbolCount; ++s)
+            {
+                if (lengths[s] == 0)
+                    continue;
+                codes[s] = next[lengths[s]]++;
+                sorted[slot[lengths[s]]++] = static_cast<uint8_t>(s);
+            }
+            return true;
+        }
+    };
+
+    class BitWriter
+    {
+    private:
+        std::vector<uint8_t> &out;
+        uint64_t buffer;
+        int bits;
+
+    public:
+        explicit BitWriter(std::vector<uint8_t> &out) : out(out), buffer(0), bits(0) {}
+
+        // value must fit in count bits, count <= 32
+        void put(uint32_t value, int count)
+        {
+            buffer = (buffer << count) | value;
+            bits += count;
+            while (bits >= 8)
+            {
+                bits -= 8;
+                out.push_back(static_cast<uint8_t>(buffer >> bits));
+            }
+        }
+
+        void flush()
+        {
+            if (bits > 0)
+                out.push_back(static_cast<uint8_t>(buffer << (8 - bits)));
+            bits = 0;
+        }
+    };
+
+    class BitReader
+    {
+    private:
+        const uint8_t *next;
+        const uint8_t *end;
+        uint64_t buffer;
+        int bits;
+
+    public:
+        BitReader(const uint8_t *data, size_t bytes) : next(data), end(data + bytes), buffer(0), bits(0) {}
+
+        uint32_t get(int count)
+        {
+            while (bits < count)
+            {
+                if (next == end)
+                    throw std::runtime_error("Trajectory frame ends early");
+                buffer = (buffer << 8) | *next++;
+                bits += 8;
+            }
+            bits -= count;
+            return static_cast<uint32_t>((buffer >> bits) & ((uint64_t(1) << count) - 1));
+        }
+
+        uint32_t decodeSymbol(const CanonicalCode &code)
+        {
+            uint32_t value = 0;
+            for (int length = 1; length <= maxCodeLength; ++length)
+            {
+                value = (value << 1) | get(1);
+                if (value - code.first[length] < code.count[length])
+                    return code.sorted[code.offset[length] + value - code.first[length]];
+            }
+            throw std::runtime_error("Invalid code in trajectory frame");
+        }
+    };
+
+    template <typename T>
+    void append(std::vector<uint8_t> &out, T value)
+    {
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    template <typename T>
+    T read(const uint8_t *&cursor, const uint8_t *end)
+    {
+        if (size_t(end - cursor) < sizeof(T))
+            throw std::runtime_error("Trajectory frame ends early");
+        T value;
+        std::memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return value;
+    }
+}
+
+TrajectoryEncoder::TrajectoryEncoder(uint32_t fields, const TrajectoryCodecSettings &settings)
+    : settings(settings), channels(makeChannels(fields)), particleCount(0), framesSinceKeyframe(0), forceKeyframe(true)
+{
+    for (float bound : {settings.errorBound, settings.velocityErrorBound, settings.densityErrorBound})
+    {
+        if (!(bound >= TrajectoryCodecSettings::minimumErrorBound && bound <= TrajectoryCodecSettings::maximumErrorBound))
+            throw std::runtime_error("Trajectory error bounds must be between 1e-6 and 0.5");
+    }
+    if (this->settings.keyframeInterval == 0)
+        this->settings.keyframeInterval = 1;
+}
+
+void TrajectoryEncoder::sortByCell(const float *frame, size_t count)
+{
+    order.resize(count);
+    if (channels.empty() || channels[0].field != TrajectoryPositions)
+    {
+        for (size_t i = 0; i < count; ++i)
+            order[i] = static_cast<uint32_t>(i);
+        return;
+    }
+
+    // about one particle per cell, rows visited in alternating directions so consecutive cells touch
+    const TrajectoryChannel &x = channels[0];
+    const TrajectoryChannel &y = channels[1];
+    float minX = valueOf(x, frame, count, 0), maxX = minX;
+    float minY = valueOf(y, frame, count, 0), maxY = minY;
+    for (size_t i = 1; i < count; ++i)
+    {
+        minX = std::min(minX, valueOf(x, frame, count, i));
+        maxX = std::max(maxX, valueOf(x, frame, count, i));
+        minY = std::min(minY, valueOf(y, frame, count, i));
+        maxY = std::max(maxY, valueOf(y, frame, count, i));
+    }
+    const size_t side = std::max<size_t>(1, static_cast<size_t>(std::sqrt(double(count))));
+    const float scaleX = side / std::max(maxX - minX, minimumRange);
+    const float scaleY = side / std::max(maxY - minY, minimumRange);
+    auto cellOf = [&](size_t i)
+    {
+        // comparisons are false for NaN, which lands in cell 0
+        float fx = (valueOf(x, frame, count, i) - minX) * scaleX;
+        float fy = (valueOf(y, frame, count, i) - minY) * scaleY;
+        size_t column = fx > 0.0f ? std::min(static_cast<size_t>(fx), side - 1) : 0;
+        size_t row = fy > 0.0f ? std::min(static_cast<size_t>(fy), side - 1) : 0;
+        return row * side + (row % 2 == 0 ? column : side - 1 - column);
+    };
+
+    cellStart.assign(side * side + 1, 0);
+    for (size_t i = 0; i < count; ++i)
+        ++cellStart[cellOf(i) + 1];
+    for (size_t c = 0; c < side * side; ++c)
+        cellStart[c + 1] += cellStart[c];
+    for (size_t i = 0; i < count; ++i)
+        order[cellStart[cellOf(i)]++] = static_cast<uint32_t>(i);
+}
+
+void TrajectoryEncoder::setRanges(const float *frame, size_t count)
+{
+    // components of a field share the step of the widest one, e.g. one bound for the whole domain
+    for (size_t c = 0; c < channels.size();)
+    {
+        size_t end = c;
+        float range = minimumRange;
+        while (end < channels.size() && channels[end].field == channels[c].field)
+        {
+            TrajectoryChannel &channel = channels[end];
+            float low = 0.0f, high = 0.0f;
+            bool any = false;
+            for (size_t i = 0; i < count; ++i)
+            {
+                float value = valueOf(channel, frame, count, i);
+                if (!std::isfinite(value))
+                    continue;
+                low = any ? std::min(low, value) : value;
+                high = any ? std::max(high, value) : value;
+                any = true;
+            }
+            channel.minimum = low;
+            range = std::max(range, high - low);
+            ++end;
+        }
+        // rounding to the nearest step is off by at most half a step
+        const uint32_t field = channels[c].field;
+        const float bound = field == TrajectoryPositions ? settings.errorBound
+                            : field == TrajectoryVelocities ? settings.velocityErrorBound
+                                                            : settings.densityErrorBound;
+        for (; c < end; ++c)
+            channels[c].step = 2.0f * bound * range;
+    }
+}
+
+bool TrajectoryEncoder::quantize(const float *frame, size_t count)
+{
+    for (TrajectoryChannel &channel : channels)
+    {
+        channel.current.resize(count);
+        // in double, so the difference of extreme floats cannot overflow
+        const double inverse = 1.0 / channel.step;
+        for (size_t i = 0; i < count; ++i)
+        {
+            // non-finite values are stored as the minimum
+            const float value = valueOf(channel, frame, count, order[i]);
+            const double scaled = std::isfinite(value) ? (double(value) - channel.minimum) * inverse : 0.0;
+            if (!(std::fabs(scaled) < double(quantizedLimit)))
+                return false;
+            channel.current[i] = static_cast<int32_t>(std::lround(scaled));
+        }
+    }
+    return true;
+}
+
+void TrajectoryEncoder::encode(const float *frame, size_t count, std::vector<uint8_t> &out)
+{
+    bool keyframe = forceKeyframe || count != particleCount || framesSinceKeyframe >= settings.keyframeInterval;
+    if (!keyframe && !quantize(frame, count))
+        keyframe = true;
+    if (keyframe)
+    {
+        sortByCell(frame, count);
+        setRanges(frame, count);
+        // fits with a valid bound; should rounding still push a value over the limit, coarser steps
+        // keep the frame instead of leaving channels unquantized
+        while (!quantize(frame, count))
+        {
+            for (TrajectoryChannel &channel : channels)
+                channel.step *= 2.0f;
+        }
+        framesSinceKeyframe = 0;
+        particleCount = count;
+        forceKeyframe = false;
+    }
+
+    append<uint32_t>(out, keyframe ? keyframeFlag : 0);
+    append<uint32_t>(out, static_cast<uint32_t>(channels.size()));
+    append<uint64_t>(out, count);
+    for (const TrajectoryChannel &channel : channels)
+    {
+        append<float>(out, channel.minimum);
+        append<float>(out, channel.step);
+    }
+
+    symbols.resize(count);
+    for (TrajectoryChannel &channel : channels)
+    {
+        uint64_t histogram[symbolCount] = {};
+        for (size_t i = 0; i < count; ++i)
+        {
+            symbols[i] = zigzag(channel.current[i] - predict(channel, i, framesSinceKeyframe));
+            ++histogram[bitLength(symbols[i])];
+        }
+
+        uint8_t lengths[symbolCount];
+        buildCodeLengths(histogram, lengths);
+        CanonicalCode code;
+        code.build(lengths);
+
+        uint64_t bitCount = 0;
+        for (int s = 0; s < symbolCount; ++s)
+            bitCount += histogram[s] * (lengths[s] + (s > 1 ? s - 1 : 0));
+        out.insert(out.end(), lengths, lengths + symbolCount);
+        append<uint64_t>(out, bitCount);
+        out.reserve(out.size() + (bitCount + 7) / 8);
+
+        BitWriter writer(out);
+        for (size_t i = 0; i < count; ++i)
+        {
+            // the leading one is implied by the bit length
+            const int length = bitLength(symbols[i]);
+            writer.put(code.codes[length], lengths[length]);
+            if (length > 1)
+                writer.put(symbols[i] & ((1u << (length - 1)) - 1), length - 1);
+        }
+        writer.flush();
+
+        std::swap(channel.beforePrevious, channel.previous);
+        std::swap(channel.previous, channel.current);
+    }
+    ++framesSinceKeyframe;
+}
+
+TrajectoryDecoder::TrajectoryDecoder(uint32_t fields)
+    : channels(makeChannels(fields)), particleCount(0), framesSinceKeyframe(0), haveKeyframe(false)
+{
+}
+
+bool TrajectoryDecoder::isKeyframe(const uint8_t *payload, size_t bytes)
+{
+    const uint8_t *cursor = payload;
+    return (read<uint32_t>(cursor, payload + bytes) & keyframeFlag) != 0;
+}
+
+uint64_t TrajectoryDecoder::frameParticleCount(const uint8_t *payload, size_t bytes)
+{
+    if (bytes < frameHeaderBytes)
+        throw std::runtime_error("Trajectory frame ends early");
+    uint64_t count;
+    std::memcpy(&count, payload + 8, sizeof(count));
+    return count;
+}
+
+void TrajectoryDecoder::decode(const uint8_t *payload, size_t bytes, std::vector<float> &frame)
+{
+    const uint8_t *cursor = payload;
+    const uint8_t *end = payload + bytes;
+    const bool keyframe = (read<uint32_t>(cursor, end) & keyframeFlag) != 0;
+    const uint32_t channelCount = read<uint32_t>(cursor, end);
+    const uint64_t count = read<uint64_t>(cursor, end);
+    if (channelCount != channels.size())
+        throw std::runtime_error("Trajectory frame does not match the file's fields");
+    if (!keyframe && (!haveKeyframe || count != particleCount))
+        throw std::runtime_error("Trajectory frame decoded without its keyframe");
+    // every residual takes at least one bit, which bounds count by the payload size
+    if (count > uint64_t(bytes) * 8)
+        throw std::runtime_error("Trajectory frame ends early");
+
+    // a frame that fails halfway leaves the group unusable
+    haveKeyframe = false;
+    if (keyframe)
+    {
+        framesSinceKeyframe = 0;
+        particleCount = count;
+    }
+    for (TrajectoryChannel &channel : channels)
+    {
+        const float minimum = read<float>(cursor, end);
+        const float step = read<float>(cursor, end);
+        if (keyframe)
+        {
+            channel.minimum = minimum;
+            channel.step = step;
+        }
+    }
+
+    frame.resize(channels.empty() ? 0 : (channels.back().base + channels.back().stride) * count);
+    for (TrajectoryChannel &channel : channels)
+    {
+        uint8_t lengths[symbolCount];
+        if (size_t(end - cursor) < symbolCount)
+            throw std::runtime_error("Trajectory frame ends early");
+        std::memcpy(lengths, cursor, symbolCount);
+        cursor += symbolCount;
+        const uint64_t bitCount = read<uint64_t>(cursor, end);
+        const uint64_t byteCount = (bitCount + 7) / 8;
+        if (uint64_t(end - cursor) < byteCount)
+            throw std::runtime_error("Trajectory frame ends early");
+
+        CanonicalCode code;
+        if (!code.build(lengths))
+            throw std::runtime_error("Invalid code in trajectory frame");
+
+        channel.current.resize(count);
+        BitReader reader(cursor, byteCount);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint32_t length = reader.decodeSymbol(code);
+            uint32_t symbol = 0;
+            if (length > 0)
+                symbol = (length > 1 ? reader.get(length - 1) : 0) | (1u << (length - 1));
+            channel.current[i] = clampQuantized(int64_t(predict(channel, i, framesSinceKeyframe)) + unzigzag(symbol));
+            valueOf(channel, frame.data(), count, i) = channel.minimum + channel.current[i] * channel.step;
+        }
+        cursor += byteCount;
+
+        std::swap(channel.beforePrevious, channel.previous);
+        std::swap(channel.previous, channel.current);
+    }
+    haveKeyframe = true;
+    ++framesSinceKeyframe;
+}
@@ -0,0 +1,244 @@
+#include "TrajectoryReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char magicBytes[8] = {'S', 'P', 'H', 'T', 'R', 'A', 'J', '\0'};
+    constexpr uint32_t byteOrderMark = 0x01020304;
+    constexpr size_t noFrame = static_cast<size_t>(-1);
+
+    size_t floatsPerParticle(uint32_t fields)
+    {
+        return ((fields & TrajectoryPositions) ? 2 : 0) + ((fields & TrajectoryVelocities) ? 2 : 0) + ((fields & TrajectoryDensities) ? 1 : 0);
+    }
+}
+
+TrajectoryReader::TrajectoryReader(const char *filename)
+    : bytes(nullptr), byteCount(0), file(nullptr), header(), decoder(0), decodedFrame(noFrame), pinnedFrame(noFrame)
+{
+#ifdef _WIN32
+    file = std::fopen(filename, "rb");
+    if (file == nullptr)
+        throw std::runtime_error(std::string("Could not open trajectory: ") + filename);
+    _fseeki64(file, 0, SEEK_END);
+    byteCount = static_cast<size_t>(_ftelli64(file));
+#else
+    int descriptor = open(filename, O_RDONLY);
+    if (descriptor < 0)
+        throw std::runtime_error(std::string("Could not open trajectory: ") + filename);
+    struct stat info;
+    if (fstat(descriptor, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(TrajectoryFileHeader)))
+    {
+        close(descriptor);
+        throw std::runtime_error(std::string("Truncated trajectory: ") + filename);
+    }
+    byteCount = static_cast<size_t>(info.st_size);
+    void *mapping = mmap(nullptr, byteCount, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error(std::string("Could not map trajectory: ") + filename);
+    bytes = static_cast<const unsigned char *>(mapping);
+#endif
+
+    auto fail = [&](const std::string &message)
+    {
+        throw std::runtime_error(message + ": " + filename);
+    };
+
+    // from here on the destructor is not run if we throw, so release by hand
+    try
+    {
+        if (byteCount < sizeof(TrajectoryFileHeader))
+            fail("Truncated trajectory");
+        std::memcpy(&header, fetch(0, sizeof(TrajectoryFileHeader)), sizeof(TrajectoryFileHeader));
+        if (std::memcmp(header.magic, magicBytes, sizeof(magicBytes)) != 0)
+            fail("Not a trajectory");
+        if (header.byteOrder != byteOrderMark)
+            fail("Trajectory has a different byte order");
+        if (header.version > TrajectoryFileHeader::currentVersion)
+            fail("Unsupported trajectory version " + std::to_string(header.version));
+        if (header.codec > TrajectoryFileHeader::compressedCodec)
+            fail("Unsupported trajectory codec " + std::to_string(header.codec));
+
+        decoder = TrajectoryDecoder(header.fields);
+        buildIndex();
+    }
+    catch (const std::runtime_error &)
+    {
+        release();
+        throw;
+    }
+}
+
+TrajectoryReader::~TrajectoryReader()
+{
+    release();
+}
+
+void TrajectoryReader::release()
+{
+#ifndef _WIN32
+    if (bytes != nullptr)
+        munmap(const_cast<unsigned char *>(bytes), byteCount);
+#endif
+    bytes = nullptr;
+    if (file != nullptr)
+        std::fclose(file);
+    file = nullptr;
+}
+
+const unsigned char *TrajectoryReader::fetch(uint64_t offset, size_t count)
+{
+    if (bytes != nullptr)
+        return bytes + offset;
+
+#ifdef _WIN32
+    staging.resize(count);
+    if (_fseeki64(file, static_cast<long long>(offset), SEEK_SET) != 0 || std::fread(staging.data(), 1, count, file) != count)
+        throw std::runtime_error("Could not read trajectory");
+#else
+    (void)count;
+#endif
+    return staging.data();
+}
+
+void TrajectoryReader::releasePages(size_t index)
+{
+#ifndef _WIN32
+    if (bytes == nullptr || index >= frames.size())
+        return;
+    // only pages wholly inside the frame, the neighbors may still be in use
+    const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    const uint64_t begin = (frames[index].payloadOffset + page - 1) / page * page;
+    const uint64_t end = (frames[index].payloadOffset + frames[index].payloadBytes) / page * page;
+    if (begin < end)
+        madvise(const_cast<unsigned char *>(bytes) + begin, end - begin, MADV_DONTNEED);
+#else
+    (void)index;
+#endif
+}
+
+void TrajectoryReader::prefetchPages(size_t index)
+{
+#ifndef _WIN32
+    if (bytes == nullptr || index >= frames.size())
+        return;
+    const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    const uint64_t begin = frames[index].payloadOffset / page * page;
+    const uint64_t end = frames[index].payloadOffset + frames[index].payloadBytes;
+    madvise(const_cast<unsigned char *>(bytes) + begin, end - begin, MADV_WILLNEED);
+#else
+    (void)index;
+#endif
+}
+
+void TrajectoryReader::buildIndex()
+{
+    const size_t rawFloats = floatsPerParticle(header.fields);
+    uint64_t offset = sizeof(TrajectoryFileHeader);
+    size_t keyframe = noFrame;
+    while (byteCount - offset >= sizeof(TrajectoryFrameHeader))
+    {
+        TrajectoryFrameHeader chunk;
+        std::memcpy(&chunk, fetch(offset, sizeof(chunk)), sizeof(chunk));
+        const uint64_t payloadOffset = offset + sizeof(chunk);
+        if (chunk.payloadBytes > byteCount - payloadOffset)
+            break;
+        offset = payloadOffset + chunk.payloadBytes;
+
+        TrajectoryFrameInfo frame = {payloadOffset, chunk.payloadBytes, chunk.step, chunk.time, chunk.particleCount, frames.size(), false};
+        if (chunk.tag == TrajectoryFrameHeader::frameTag)
+        {
+            // divided, a corrupt count could wrap the product around to the payload size
+            const uint64_t particleBytes = rawFloats * sizeof(float);
+            if (particleBytes == 0 || chunk.payloadBytes % particleBytes != 0 || chunk.payloadBytes / particleBytes != chunk.particleCount)
+                break;
+        }
+        else if (chunk.tag == TrajectoryFrameHeader::compressedFrameTag)
+        {
+            frame.compressed = true;
+            if (chunk.payloadBytes < sizeof(uint32_t))
+                break;
+            if (TrajectoryDecoder::isKeyframe(fetch(payloadOffset, sizeof(uint32_t)), sizeof(uint32_t)))
+                keyframe = frames.size();
+            // frames before the first keyframe cannot be decoded
+            if (keyframe == noFrame)
+                continue;
+            frame.keyframe = keyframe;
+        }
+        else
+            continue;
+        frames.push_back(frame);
+    }
+
+#ifndef _WIN32
+    // walking the headers touched a page per frame
+    if (bytes != nullptr)
+        madvise(const_cast<unsigned char *>(bytes), byteCount, MADV_DONTNEED);
+#endif
+}
+
+size_t TrajectoryReader::findFrame(double time) const
+{
+    auto after = std::upper_bound(frames.begin(), frames.end(), time, [](double t, const TrajectoryFrameInfo &frame)
+                                  { return t < frame.time; });
+    return after == frames.begin() ? 0 : static_cast<size_t>(after - frames.begin()) - 1;
+}
+
+const float *TrajectoryReader::readFrame(size_t index)
+{
+    if (index >= frames.size())
+        throw std::runtime_error("Trajectory frame " + std::to_string(index) + " out of range");
+    if (pinnedFrame != index)
+        releasePages(pinnedFrame);
+    pinnedFrame = noFrame;
+
+    const TrajectoryFrameInfo &frame = frames[index];
+    if (!frame.compressed)
+    {
+        const unsigned char *payload = fetch(frame.payloadOffset, static_cast<size_t>(frame.payloadBytes));
+        prefetchPages(index + 1);
+        if (reinterpret_cast<uintptr_t>(payload) % alignof(float) == 0)
+        {
+            pinnedFrame = index;
+            return reinterpret_cast<const float *>(payload);
+        }
+        aligned.resize(static_cast<size_t>(frame.payloadBytes / sizeof(float)));
+        std::memcpy(aligned.data(), payload, static_cast<size_t>(frame.payloadBytes));
+        releasePages(index);
+        return aligned.data();
+    }
+
+    if (decodedFrame == index)
+        return decoded.data();
+
+    // continue forward inside the group when possible, otherwise start over at its keyframe
+    size_t next = frame.keyframe;
+    if (decodedFrame != noFrame && decodedFrame < index && frames[decodedFrame].keyframe == frame.keyframe)
+        next = decodedFrame + 1;
+    decodedFrame = noFrame;
+    for (; next <= index; ++next)
+    {
+        const TrajectoryFrameInfo &step = frames[next];
+        decoder.decode(fetch(step.payloadOffset, static_cast<size_t>(step.payloadBytes)), static_cast<size_t>(step.payloadBytes), decoded);
+        releasePages(next);
+        // callers size their reads by the chunk header's count, which the payload must agree with
+        const size_t floats = floatsPerParticle(header.fields);
+        if (floats == 0 || decoded.size() % floats != 0 || decoded.size() / floats != step.particleCount)
+            throw std::runtime_error("Trajectory frame " + std::to_string(next) + " holds a different particle count than its header");
+    }
+    decodedFrame = index;
+    prefetchPages(index + 1);
+    return decoded.data();
+}
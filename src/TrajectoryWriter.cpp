@@ -0,0 +1,200 @@
+#include "TrajectoryWriter.h"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    const char magicBytes[8] = {'S', 'P', 'H', 'T', 'R', 'A', 'J', '\0'};
+    constexpr size_t fileBufferBytes = 1 << 20;
+}
+
+TrajectoryWriter::TrajectoryWriter(const char *filename, uint32_t interval, uint32_t fields, const TrajectoryCodecSettings *compression)
+    : file(nullptr), fields(fields), interval(interval > 0 ? interval : 1), nextSequence(0), stopping(false)
+{
+    // before opening the file, a rejected codec setting must not leave it behind
+    if (compression != nullptr)
+        encoder.reset(new TrajectoryEncoder(fields, *compression));
+
+    file = std::fopen(filename, "wb");
+    if (file == nullptr)
+        throw std::runtime_error(std::string("Could not create trajectory file: ") + filename);
+    std::setvbuf(file, nullptr, _IOFBF, fileBufferBytes);
+
+    TrajectoryFileHeader header = {};
+    std::memcpy(header.magic, magicBytes, sizeof(magicBytes));
+    header.version = TrajectoryFileHeader::currentVersion;
+    header.byteOrder = 0x01020304;
+    header.fields = fields;
+    header.interval = this->interval;
+    if (compression != nullptr)
+    {
+        header.codec = TrajectoryFileHeader::compressedCodec;
+        header.errorBound = compression->errorBound;
+    }
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1)
+        stats.writeFailed = true;
+    stats.bytesWritten = sizeof(header);
+
+    writer = std::thread(&TrajectoryWriter::writerLoop, this);
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+    finish();
+}
+
+TrajectoryStats TrajectoryWriter::finish()
+{
+    if (writer.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        filled.notify_one();
+        writer.join();
+        // the last buffered bytes only reach the disk here
+        if (std::fclose(file) != 0)
+            stats.writeFailed = true;
+        file = nullptr;
+    }
+    return getStats();
+}
+
+template <typename Real>
+void TrajectoryWriter::pack(Slot &slot, const std::vector<BasicParticle<Real>> &particles) const
+{
+    const size_t count = particles.size();
+    size_t floats = 0;
+    if (fields & TrajectoryPositions)
+        floats += 2 * count;
+    if (fields & TrajectoryVelocities)
+        floats += 2 * count;
+    if (fields & TrajectoryDensities)
+        floats += count;
+    slot.data.resize(floats);
+
+    // structure of arrays, so readers can map one field without striding over the others
+    float *out = slot.data.data();
+    if (fields & TrajectoryPositions)
+    {
+        for (const auto &particle : particles)
+        {
+            *out++ = static_cast<float>(particle.position.x);
+            *out++ = static_cast<float>(particle.position.y);
+        }
+    }
+    if (fields & TrajectoryVelocities)
+    {
+        for (const auto &particle : particles)
+        {
+            *out++ = static_cast<float>(particle.velocity.x);
+            *out++ = static_cast<float>(particle.velocity.y);
+        }
+    }
+    if (fields & TrajectoryDensities)
+    {
+        for (const auto &particle : particles)
+            *out++ = static_cast<float>(particle.density);
+    }
+}
+
+template <typename Real>
+void TrajectoryWriter::record(const std::vector<BasicParticle<Real>> &particles, uint64_t step, double time)
+{
+    if (step % interval != 0)
+        return;
+
+    Slot *slot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++stats.framesOffered;
+        for (Slot &candidate : slots)
+        {
+            if (candidate.state == SlotState::Free)
+            {
+                slot = &candidate;
+                break;
+            }
+        }
+        if (slot == nullptr || stats.writeFailed || stopping)
+        {
+            ++stats.framesDropped;
+            return;
+        }
+    }
+
+    // a free slot belongs to this thread until it is marked filled
+    pack(*slot, particles);
+    slot->header = TrajectoryFrameHeader{TrajectoryFrameHeader::frameTag, 0, slot->data.size() * sizeof(float), step, time, particles.size()};
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        slot->state = SlotState::Filled;
+        slot->sequence = nextSequence++;
+    }
+    filled.notify_one();
+}
+
+template void TrajectoryWriter::record(const std::vector<Particle> &, uint64_t, double);
+template void TrajectoryWriter::record(const std::vector<ParticleD> &, uint64_t, double);
+
+void TrajectoryWriter::writerLoop()
+{
+    for (;;)
+    {
+        Slot *slot = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // oldest filled frame first, so the file stays in step order
+            filled.wait(lock, [&]
+                        {
+                for (Slot &candidate : slots)
+                {
+                    if (candidate.state == SlotState::Filled && (slot == nullptr || candidate.sequence < slot->sequence))
+                        slot = &candidate;
+                }
+                return slot != nullptr || stopping; });
+            if (slot == nullptr)
+                return;
+            slot->state = SlotState::Writing;
+        }
+
+        const uint64_t rawBytes = slot->header.payloadBytes;
+        const void *payload = slot->data.data();
+        auto start = std::chrono::steady_clock::now();
+        if (encoder)
+        {
+            encoded.clear();
+            encoder->encode(slot->data.data(), slot->header.particleCount, encoded);
+            slot->header.tag = TrajectoryFrameHeader::compressedFrameTag;
+            slot->header.payloadBytes = encoded.size();
+            payload = encoded.data();
+        }
+        auto encodeEnd = std::chrono::steady_clock::now();
+        bool ok = std::fwrite(&slot->header, sizeof(slot->header), 1, file) == 1 &&
+                  std::fwrite(payload, 1, slot->header.payloadBytes, file) == slot->header.payloadBytes;
+        auto writeEnd = std::chrono::steady_clock::now();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        slot->state = SlotState::Free;
+        stats.encodeSeconds += std::chrono::duration<double>(encodeEnd - start).count();
+        stats.writeSeconds += std::chrono::duration<double>(writeEnd - encodeEnd).count();
+        if (ok)
+        {
+            ++stats.framesWritten;
+            stats.bytesWritten += sizeof(slot->header) + slot->header.payloadBytes;
+            stats.rawBytes += rawBytes;
+        }
+        else
+            stats.writeFailed = true;
+    }
+}
+
+TrajectoryStats TrajectoryWriter::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
@@ -13,6 +13,15 @@ void VAO::LinkVBO(VBO& VBO, GLuint layout)
     VBO.Unbind();
 }
 
+void VAO::LinkAttrib(VBO& VBO, GLuint layout, GLint components, GLsizei stride, GLsizeiptr offset, GLuint divisor)
+{
+    VBO.Bind();
+    glVertexAttribPointer(layout, components, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+    glEnableVertexAttribArray(layout);
+    glVertexAttribDivisor(layout, divisor);
+    VBO.Unbind();
+}
+
 void VAO::Bind()
 {
     glBindVertexArray(ID); // makes the vao the current object
@@ -7,6 +7,13 @@ VBO::VBO(GLfloat* vertices, GLsizeiptr size)
     glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
 }
 
+void VBO::Update(const GLvoid* data, GLsizeiptr size)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, ID);
+    // fresh storage each time, so the driver does not wait for draws still reading the old frame
+    glBufferData(GL_ARRAY_BUFFER, size, data, GL_STREAM_DRAW);
+}
+
 void VBO::Bind()
 {
     glBindBuffer(GL_ARRAY_BUFFER, ID);
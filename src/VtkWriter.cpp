@@ -0,0 +1,248 @@
+#include "VtkWriter.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    constexpr size_t blockParticles = 4096;         // converted per fwrite, so pieces need no full-size buffer
+    constexpr size_t minimumPieceParticles = 65536; // smaller steps are not worth splitting
+    constexpr size_t fileBufferBytes = 1 << 20;
+
+    const char *byteOrder()
+    {
+        const uint16_t probe = 1;
+        unsigned char first;
+        std::memcpy(&first, &probe, 1);
+        return first == 1 ? "LittleEndian" : "BigEndian";
+    }
+
+    std::string stepName(const std::string &name, uint64_t step)
+    {
+        char digits[32];
+        std::snprintf(digits, sizeof(digits), "_%06llu", static_cast<unsigned long long>(step));
+        return name + digits;
+    }
+
+    // Appended arrays in the order the piece header declares them
+    enum Array
+    {
+        Points,
+        Velocity,
+        Density,
+        Pressure,
+        Connectivity,
+        Offsets,
+        ArrayCount
+    };
+
+    const size_t arrayComponents[ArrayCount] = {3, 3, 1, 1, 1, 1};
+
+    template <typename Real>
+    bool writePiece(const std::string &filename, const BasicParticle<Real> *particles, size_t count, const SimulationParameters &parameters)
+    {
+        FILE *file = std::fopen(filename.c_str(), "wb");
+        if (file == nullptr)
+            return false;
+        std::setvbuf(file, nullptr, _IOFBF, fileBufferBytes);
+
+        // every block is a UInt64 byte count followed by the data, offsets count from the '_' marker
+        uint64_t offsets[ArrayCount];
+        uint64_t offset = 0;
+        for (int a = 0; a < ArrayCount; ++a)
+        {
+            offsets[a] = offset;
+            offset += sizeof(uint64_t) + count * arrayComponents[a] * 4;
+        }
+
+        auto ull = [](uint64_t value)
+        { return static_cast<unsigned long long>(value); };
+        std::fprintf(file,
+                     "<?xml version=\"1.0\"?>\n"
+                     "<VTKFile type=\"PolyData\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\">\n"
+                     "  <PolyData>\n"
+                     "    <Piece NumberOfPoints=\"%llu\" NumberOfVerts=\"%llu\" NumberOfLines=\"0\" NumberOfStrips=\"0\" NumberOfPolys=\"0\">\n"
+                     "      <PointData Scalars=\"density\" Vectors=\"velocity\">\n"
+                     "        <DataArray type=\"Float32\" Name=\"velocity\" NumberOfComponents=\"3\" format=\"appended\" offset=\"%llu\"/>\n"
+                     "        <DataArray type=\"Float32\" Name=\"density\" format=\"appended\" offset=\"%llu\"/>\n"
+                     "        <DataArray type=\"Float32\" Name=\"pressure\" format=\"appended\" offset=\"%llu\"/>\n"
+                     "      </PointData>\n"
+                     "      <Points>\n"
+                     "        <DataArray type=\"Float32\" Name=\"Points\" NumberOfComponents=\"3\" format=\"appended\" offset=\"%llu\"/>\n"
+                     "      </Points>\n"
+                     "      <Verts>\n"
+                     "        <DataArray type=\"Int32\" Name=\"connectivity\" format=\"appended\" offset=\"%llu\"/>\n"
+                     "        <DataArray type=\"Int32\" Name=\"offsets\" format=\"appended\" offset=\"%llu\"/>\n"
+                     "      </Verts>\n"
+                     "    </Piece>\n"
+                     "  </PolyData>\n"
+                     "  <AppendedData encoding=\"raw\">\n"
+                     "   _",
+                     byteOrder(), ull(count), ull(count), ull(offsets[Velocity]), ull(offsets[Density]), ull(offsets[Pressure]),
+                     ull(offsets[Points]), ull(offsets[Connectivity]), ull(offsets[Offsets]));
+
+        union Block
+        {
+            float f[blockParticles * 3];
+            int32_t i[blockParticles];
+        } block;
+        const float targetDensity = parameters.targetDensity;
+        const float pressureMultiplier = parameters.pressureMultiplier;
+        bool ok = true;
+        for (int a = 0; a < ArrayCount && ok; ++a)
+        {
+            const uint64_t bytes = count * arrayComponents[a] * 4;
+            ok = std::fwrite(&bytes, sizeof(bytes), 1, file) == 1;
+            for (size_t begin = 0; begin < count && ok; begin += blockParticles)
+            {
+                const size_t end = std::min(begin + blockParticles, count);
+                float *out = block.f;
+                switch (a)
+                {
+                case Points:
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        *out++ = static_cast<float>(particles[i].position.x);
+                        *out++ = static_cast<float>(particles[i].position.y);
+                        *out++ = 0.0f;
+                    }
+                    break;
+                case Velocity:
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        *out++ = static_cast<float>(particles[i].velocity.x);
+                        *out++ = static_cast<float>(particles[i].velocity.y);
+                        *out++ = 0.0f;
+                    }
+                    break;
+                case Density:
+                    for (size_t i = begin; i < end; ++i)
+                        *out++ = static_cast<float>(particles[i].density);
+                    break;
+                case Pressure:
+                    // same equation of state as the solver
+                    for (size_t i = begin; i < end; ++i)
+                        *out++ = std::max((static_cast<float>(particles[i].density) - targetDensity) * pressureMultiplier, 0.0f);
+                    break;
+                case Connectivity:
+                    for (size_t i = begin; i < end; ++i)
+                        block.i[i - begin] = static_cast<int32_t>(i);
+                    break;
+                case Offsets:
+                    for (size_t i = begin; i < end; ++i)
+                        block.i[i - begin] = static_cast<int32_t>(i + 1);
+                    break;
+                }
+                const size_t values = (end - begin) * arrayComponents[a];
+                ok = std::fwrite(block.f, 4, values, file) == values;
+            }
+        }
+        ok = ok && std::fputs("\n  </AppendedData>\n</VTKFile>\n", file) >= 0;
+        return std::fclose(file) == 0 && ok;
+    }
+}
+
+VtkWriter::VtkWriter(const char *basename, ThreadPool *pool, size_t pieceCount)
+    : pool(pool), pieceCount(pieceCount)
+{
+    const std::string path(basename);
+    const size_t separator = path.find_last_of("/\\");
+    directory = separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+    name = separator == std::string::npos ? path : path.substr(separator + 1);
+}
+
+template <typename Real>
+void VtkWriter::writeStep(const std::vector<BasicParticle<Real>> &particles, const SimulationParameters &parameters, uint64_t step, double time)
+{
+    const std::string stepFile = stepName(name, step);
+    const size_t count = particles.size();
+    size_t pieces = pieceCount;
+    if (pieces == 0)
+        pieces = std::min<size_t>(pool ? pool->size() : 1, (count + minimumPieceParticles - 1) / minimumPieceParticles);
+    pieces = std::max<size_t>(1, std::min(pieces, count));
+
+    // a task per piece; failures are collected, exceptions must not escape the pool's threads
+    std::vector<char> written(pieces, 0);
+    auto writeRange = [&](size_t begin, size_t end)
+    {
+        for (size_t piece = begin; piece < end; ++piece)
+        {
+            const size_t first = count * piece / pieces;
+            const size_t last = count * (piece + 1) / pieces;
+            const std::string filename = directory + stepFile + "_" + std::to_string(piece) + ".vtp";
+            written[piece] = writePiece(filename, particles.data() + first, last - first, parameters);
+        }
+    };
+    if (pool && pieces > 1)
+        pool->parallelFor(0, pieces, writeRange);
+    else
+        writeRange(0, pieces);
+    for (size_t piece = 0; piece < pieces; ++piece)
+    {
+        if (!written[piece])
+            throw std::runtime_error("Could not write VTK piece: " + directory + stepFile + "_" + std::to_string(piece) + ".vtp");
+    }
+
+    const std::string summary = directory + stepFile + ".pvtp";
+    FILE *file = std::fopen(summary.c_str(), "wb");
+    if (file == nullptr)
+        throw std::runtime_error("Could not write VTK file: " + summary);
+    std::fprintf(file,
+                 "<?xml version=\"1.0\"?>\n"
+                 "<VTKFile type=\"PPolyData\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\">\n"
+                 "  <PPolyData GhostLevel=\"0\">\n"
+                 "    <PPointData Scalars=\"density\" Vectors=\"velocity\">\n"
+                 "      <PDataArray type=\"Float32\" Name=\"velocity\" NumberOfComponents=\"3\"/>\n"
+                 "      <PDataArray type=\"Float32\" Name=\"density\"/>\n"
+                 "      <PDataArray type=\"Float32\" Name=\"pressure\"/>\n"
+                 "    </PPointData>\n"
+                 "    <PPoints>\n"
+                 "      <PDataArray type=\"Float32\" Name=\"Points\" NumberOfComponents=\"3\"/>\n"
+                 "    </PPoints>\n",
+                 byteOrder());
+    for (size_t piece = 0; piece < pieces; ++piece)
+        std::fprintf(file, "    <Piece Source=\"%s_%zu.vtp\"/>\n", stepFile.c_str(), piece);
+    std::fputs("  </PPolyData>\n</VTKFile>\n", file);
+    if (std::fclose(file) != 0)
+        throw std::runtime_error("Could not write VTK file: " + summary);
+
+    // exporting a step again replaces its entry
+    auto existing = std::find_if(steps.begin(), steps.end(), [&](const std::pair<double, std::string> &entry)
+                                 { return entry.second == stepFile + ".pvtp"; });
+    if (existing != steps.end())
+        existing->first = time;
+    else
+        steps.emplace_back(time, stepFile + ".pvtp");
+    writeCollection();
+}
+
+template void VtkWriter::writeStep(const std::vector<Particle> &, const SimulationParameters &, uint64_t, double);
+template void VtkWriter::writeStep(const std::vector<ParticleD> &, const SimulationParameters &, uint64_t, double);
+
+void VtkWriter::writeCollection() const
+{
+    // rewritten after every step through a temporary, so ParaView never sees half an index
+    const std::string collection = directory + name + ".pvd";
+    const std::string temporary = collection + ".tmp";
+    FILE *file = std::fopen(temporary.c_str(), "wb");
+    if (file == nullptr)
+        throw std::runtime_error("Could not write VTK file: " + temporary);
+    std::fprintf(file,
+                 "<?xml version=\"1.0\"?>\n"
+                 "<VTKFile type=\"Collection\" version=\"0.1\" byte_order=\"%s\">\n"
+                 "  <Collection>\n",
+                 byteOrder());
+    for (const auto &entry : steps)
+        std::fprintf(file, "    <DataSet timestep=\"%.17g\" group=\"\" part=\"0\" file=\"%s\"/>\n", entry.first, entry.second.c_str());
+    std::fputs("  </Collection>\n</VTKFile>\n", file);
+    if (std::fclose(file) != 0)
+        throw std::runtime_error("Could not write VTK file: " + temporary);
+
+    // rename cannot replace an existing file everywhere, fall back to remove + rename
+    if (std::rename(temporary.c_str(), collection.c_str()) != 0 &&
+        (std::remove(collection.c_str()) != 0 || std::rename(temporary.c_str(), collection.c_str()) != 0))
+        throw std::runtime_error("Could not replace VTK file: " + collection);
+}
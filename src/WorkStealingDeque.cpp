@@ -0,0 +1,68 @@
+#include "WorkStealingDeque.h"
+
+// Memory orders follow Le et al., "Correct and Efficient Work-Stealing for Weak Memory Models"
+
+WorkStealingDeque::WorkStealingDeque()
+    : top(0), bottom(0), capacity(0), mask(0)
+{
+}
+
+void WorkStealingDeque::reset(size_t minimumCapacity)
+{
+    if (minimumCapacity > capacity)
+    {
+        size_t size = 1;
+        while (size < minimumCapacity)
+            size <<= 1;
+        buffer.reset(new std::atomic<uint32_t>[size]);
+        capacity = size;
+        mask = static_cast<int64_t>(size - 1);
+    }
+    top.store(0, std::memory_order_relaxed);
+    bottom.store(0, std::memory_order_relaxed);
+}
+
+void WorkStealingDeque::push(uint32_t value)
+{
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    buffer[b & mask].store(value, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+bool WorkStealingDeque::pop(uint32_t &value)
+{
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b)
+    {
+        // empty
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    value = buffer[b & mask].load(std::memory_order_relaxed);
+    if (t == b)
+    {
+        // last element: race the thieves for it
+        bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+bool WorkStealingDeque::steal(uint32_t &value)
+{
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b)
+        return false;
+
+    value = buffer[t & mask].load(std::memory_order_relaxed);
+    return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
@@ -0,0 +1,95 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+
+#include "Simulation.h"
+#include "ThreadPool.h"
+
+// Every global allocation in the process, including the pool's threads
+static std::atomic<size_t> allocationCount(0);
+
+void *operator new(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (void *memory = std::malloc(size > 0 ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+// Steps a settled simulation and fails if any step after the warm-up touches the heap
+static bool checkSteadyState(const char *name, BoundaryType boundary, ThreadPool *pool)
+{
+	const int warmupSteps = 200;
+	const int measuredSteps = 1000;
+
+	std::mt19937 rng(1);
+	std::vector<Particle> particles = generateParticles(2000, -0.5f, 0.5f, -0.5f, 0.5f, rng);
+	std::unique_ptr<SimulationBase> simulation = makeSimulation(KernelType::Poly6Spiky, IntegratorType::Verlet, boundary,
+																 0.05f, 1.0f, 1.0f, 1.0f, 10000.0f);
+	simulation->setThreadPool(pool);
+
+	// the mouse alternates so the interaction field path runs too
+	for (int step = 0; step < warmupSteps; ++step)
+		simulation->updateParticles(particles, 0.003f, glm::vec3(0.3f, 0.0f, step % 2 ? 0.2f : 0.0f));
+
+	int failedSteps = 0;
+	size_t total = 0;
+	for (int step = 0; step < measuredSteps; ++step)
+	{
+		const size_t before = allocationCount.load();
+		simulation->updateParticles(particles, 0.003f, glm::vec3(0.3f, 0.0f, step % 2 ? 0.2f : 0.0f));
+		const size_t allocations = allocationCount.load() - before;
+		failedSteps += allocations > 0;
+		total += allocations;
+	}
+	std::printf("%-24s %d of %d steps allocated (%zu allocations)\n", name, failedSteps, measuredSteps, total);
+	return failedSteps == 0;
+}
+
+// A steady simulation must not allocate: scratch comes from the step arena, and the grid, hash and
+// task graph keep their capacity from step to step
+int main()
+{
+	bool ok = true;
+	ok &= checkSteadyState("box", BoundaryType::Box, nullptr);
+	ok &= checkSteadyState("periodic", BoundaryType::Periodic, nullptr);
+	ok &= checkSteadyState("open", BoundaryType::Open, nullptr);
+	{
+		ThreadPool pool(4);
+		ok &= checkSteadyState("box, pool", BoundaryType::Box, &pool);
+		ok &= checkSteadyState("open, pool", BoundaryType::Open, &pool);
+	}
+	{
+		ThreadPool pool(4, true);
+		ok &= checkSteadyState("box, NUMA pool", BoundaryType::Box, &pool);
+	}
+	return ok ? 0 : 1;
+}
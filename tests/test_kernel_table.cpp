@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "KernelTable.h"
+
+// Largest error of the table at smoothing length h against the closed forms, relative to their peaks
+static void sweepError(const KernelTable &table, float h, float &valueError, float &gradientError)
+{
+	const int sweep = 10000;
+	float peakValue = 0.0f, peakGradient = 0.0f;
+	valueError = 0.0f;
+	gradientError = 0.0f;
+	for (int i = 0; i <= sweep; ++i)
+	{
+		const float r = h * i / sweep;
+		const float exactValue = KernelTable::analyticValue(table.getShape(), r, h);
+		const float exactGradient = KernelTable::analyticGradient(table.getShape(), r, h);
+		peakValue = std::max(peakValue, std::abs(exactValue));
+		peakGradient = std::max(peakGradient, std::abs(exactGradient));
+		valueError = std::max(valueError, std::abs(table.value(r * r, h) - exactValue));
+		gradientError = std::max(gradientError, std::abs(table.gradient(r, h) - exactGradient));
+	}
+	valueError /= peakValue;
+	gradientError /= peakGradient;
+}
+
+// The tabulated kernels must match their analytic forms, at the unit smoothing length validate()
+// sweeps and at the viewer's particle radius
+int main()
+{
+	// linear interpolation over 512 samples; values indexed by q^2 are least accurate near the origin,
+	// where the cubic spline and Wendland C2 are odd in q (about 8e-5 and 2.4e-4 of the peak)
+	const float valueBound = 5e-4f;
+	const float gradientBound = 1e-4f;
+
+	const struct
+	{
+		KernelShape shape;
+		const char *name;
+	} shapes[] = {{KernelShape::Poly6Spiky, "poly6/spiky"}, {KernelShape::CubicSpline, "cubic spline"}, {KernelShape::WendlandC2, "wendland c2"}};
+
+	bool ok = true;
+	for (const auto &entry : shapes)
+	{
+		const KernelTable table(entry.shape);
+		float valueError, gradientError;
+		table.validate(valueError, gradientError);
+		float scaledValueError, scaledGradientError;
+		sweepError(table, 0.05f, scaledValueError, scaledGradientError);
+
+		// zero outside the support radius
+		const bool outside = table.value(1.0001f, 1.0f) == 0.0f && table.gradient(1.0001f, 1.0f) == 0.0f;
+		const bool passed = valueError < valueBound && gradientError < gradientBound &&
+							scaledValueError < valueBound && scaledGradientError < gradientBound && outside;
+		std::printf("%-14s value %.2e (h=0.05: %.2e), gradient %.2e (h=0.05: %.2e)%s %s\n", entry.name, valueError,
+					scaledValueError, gradientError, scaledGradientError, outside ? "" : ", nonzero outside", passed ? "ok" : "FAILED");
+		ok &= passed;
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "Simulation.h"
+
+static bool throwsOnBake(const std::vector<uint8_t> &pixels, int size)
+{
+	SignedDistanceField field(glm::vec2(-1.0f), glm::vec2(1.0f), 64);
+	try
+	{
+		field.bakeBitmap(pixels, size, size);
+	}
+	catch (const std::runtime_error &)
+	{
+		return true;
+	}
+	return false;
+}
+
+// Geometry without a solid/fluid interface is rejected at bake time, and non-finite particles
+// sample a border node instead of reading outside the field
+int main()
+{
+	bool ok = true;
+	auto check = [&](bool passed, const char *name)
+	{
+		std::printf("%-36s %s\n", name, passed ? "ok" : "FAILED");
+		ok &= passed;
+	};
+
+	const int size = 32;
+	check(throwsOnBake(std::vector<uint8_t>(size * size, 0), size), "all-solid bitmap throws");
+	check(throwsOnBake(std::vector<uint8_t>(size * size, 255), size), "all-fluid bitmap throws");
+
+	bool emptyContainer = false;
+	try
+	{
+		SignedDistanceField field(glm::vec2(-1.0f), glm::vec2(1.0f), 64);
+		field.bakePolylines({Polyline()}, {});
+	}
+	catch (const std::runtime_error &)
+	{
+		emptyContainer = true;
+	}
+	check(emptyContainer, "container without vertices throws");
+
+	// solid floor over the bottom quarter
+	std::vector<uint8_t> pixels(size * size, 255);
+	for (int i = 0; i < size * size / 4; ++i)
+		pixels[i] = 0;
+	SignedDistanceField field(glm::vec2(-1.0f), glm::vec2(1.0f), 64);
+	field.bakeBitmap(pixels, size, size);
+
+	const float inf = std::numeric_limits<float>::infinity();
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	bool finite = true;
+	for (const glm::vec2 &pos : {glm::vec2(nan), glm::vec2(nan, 0.0f), glm::vec2(inf), glm::vec2(-inf), glm::vec2(1e30f, -1e30f)})
+	{
+		float distance;
+		glm::vec2 normal;
+		field.sample(pos, distance, normal);
+		finite &= std::isfinite(distance) && std::isfinite(normal.x) && std::isfinite(normal.y);
+	}
+	check(finite, "non-finite positions sample finitely");
+
+	// one NaN particle must not take the step down or spread to its neighbors
+	auto simulation = makeSimulation(KernelType::Poly6Spiky, IntegratorType::Verlet, BoundaryType::SDF, 0.05f, 1.0f, 1.0f, 1.0f, 10000.0f);
+	simulation->setBoundaryField(&field);
+	std::vector<Particle> particles = generateUniformGridParticles(400, -0.5f, 0.5f, -0.5f, 0.5f);
+	particles[7].position = glm::vec2(nan);
+	particles[7].setPrevious(glm::vec2(nan));
+	const std::vector<InteractionField> fields;
+	for (int step = 0; step < 20; ++step)
+		simulation->updateParticles(particles, 0.003f, fields);
+	size_t finiteParticles = 0;
+	for (const Particle &particle : particles)
+		finiteParticles += std::isfinite(particle.position.x) && std::isfinite(particle.position.y);
+	check(finiteParticles == particles.size() - 1, "NaN particle stays isolated");
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "Simulation.h"
+#include "TrajectoryCodec.h"
+#include "TrajectoryWriter.h"
+
+namespace
+{
+	const uint32_t allFields = TrajectoryPositions | TrajectoryVelocities | TrajectoryDensities;
+
+	// Writer layout: positions, velocities, densities. The density is the particle index, so decoded
+	// particles, which come out in the keyframe's cell order, can be matched to their originals.
+	std::vector<float> makeFrame(size_t count, int frame)
+	{
+		std::vector<float> data(5 * count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const float phase = 0.37f * i + 0.05f * frame;
+			data[2 * i] = 0.8f * std::sin(phase) * std::cos(0.011f * i);
+			data[2 * i + 1] = 0.8f * std::cos(1.3f * phase) - 0.001f * frame;
+			data[2 * count + 2 * i] = 0.05f * std::cos(phase);
+			data[2 * count + 2 * i + 1] = -0.065f * std::sin(1.3f * phase);
+			data[4 * count + i] = static_cast<float>(i);
+		}
+		return data;
+	}
+
+	// Widest component range of each field, which the codec's error bound is relative to
+	void fieldRanges(const std::vector<float> &data, size_t count, float ranges[3])
+	{
+		const size_t base[3] = {0, 2 * count, 4 * count};
+		const size_t components[3] = {2, 2, 1};
+		for (int f = 0; f < 3; ++f)
+		{
+			ranges[f] = 0.0f;
+			for (size_t c = 0; c < components[f]; ++c)
+			{
+				float low = FLT_MAX, high = -FLT_MAX;
+				for (size_t i = 0; i < count; ++i)
+				{
+					low = std::min(low, data[base[f] + i * components[f] + c]);
+					high = std::max(high, data[base[f] + i * components[f] + c]);
+				}
+				ranges[f] = std::max(ranges[f], high - low);
+			}
+		}
+	}
+
+	TrajectoryCodecSettings uniformBound(float errorBound)
+	{
+		TrajectoryCodecSettings settings;
+		settings.errorBound = errorBound;
+		settings.velocityErrorBound = errorBound;
+		settings.densityErrorBound = errorBound;
+		return settings;
+	}
+
+	// Encodes and decodes frames, returns the largest error relative to each field's bound * range
+	// (<= 1 passes). Matching by density needs densityErrorBound * count < 0.5.
+	float roundTrip(const TrajectoryCodecSettings &settings, size_t count, int frames)
+	{
+		const float bounds[3] = {settings.errorBound, settings.velocityErrorBound, settings.densityErrorBound};
+		TrajectoryEncoder encoder(allFields, settings);
+		TrajectoryDecoder decoder(allFields);
+
+		std::vector<uint8_t> payload;
+		std::vector<float> decoded;
+		float ranges[3] = {};
+		float worst = 0.0f;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			const std::vector<float> original = makeFrame(count, frame);
+			payload.clear();
+			encoder.encode(original.data(), count, payload);
+			if (TrajectoryDecoder::isKeyframe(payload.data(), payload.size()))
+				fieldRanges(original, count, ranges);
+			decoder.decode(payload.data(), payload.size(), decoded);
+			if (decoded.size() != original.size())
+				return std::numeric_limits<float>::infinity();
+
+			for (size_t d = 0; d < count; ++d)
+			{
+				const long i = std::lround(decoded[4 * count + d]);
+				if (i < 0 || i >= static_cast<long>(count))
+					return std::numeric_limits<float>::infinity();
+				// decoding computes minimum + value * step in float, which rounds by a few ulps on top
+				auto error = [&](size_t decodedIndex, size_t originalIndex, float range)
+				{
+					const float value = original[originalIndex];
+					const float rounding = 2.0f * FLT_EPSILON * (range + std::abs(value));
+					return std::max(std::abs(decoded[decodedIndex] - value) - rounding, 0.0f) / range;
+				};
+				const float errors[5] = {
+					error(2 * d, 2 * i, ranges[0]) / bounds[0],
+					error(2 * d + 1, 2 * i + 1, ranges[0]) / bounds[0],
+					error(2 * count + 2 * d, 2 * count + 2 * i, ranges[1]) / bounds[1],
+					error(2 * count + 2 * d + 1, 2 * count + 2 * i + 1, ranges[1]) / bounds[1],
+					error(4 * count + d, 4 * count + i, ranges[2]) / bounds[2]};
+				for (float error : errors)
+					worst = std::max(worst, error);
+			}
+		}
+		return worst;
+	}
+
+	bool rejected(const TrajectoryCodecSettings &settings)
+	{
+		try
+		{
+			TrajectoryEncoder encoder(allFields, settings);
+		}
+		catch (const std::runtime_error &)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	// Compression ratio of the fields the viewer records, on frames of a running simulation: 4000
+	// particles settling in the box, a frame every 10 steps as with the default recording interval
+	double simulatedRatio(const TrajectoryCodecSettings &settings, int frames)
+	{
+		std::mt19937 rng(1);
+		std::vector<Particle> particles = generateParticles(4000, -0.5f, 0.5f, -0.5f, 0.5f, rng);
+		Simulation simulation(0.05f, 1.0f, 1.0f, 1.0f, 10000.0f);
+		const std::vector<InteractionField> fields;
+		TrajectoryEncoder encoder(allFields, settings);
+
+		const size_t count = particles.size();
+		std::vector<float> frame(5 * count);
+		std::vector<uint8_t> payload;
+		size_t rawBytes = 0, codedBytes = 0;
+		for (int f = 0; f < frames; ++f)
+		{
+			for (int step = 0; step < 10; ++step)
+				simulation.updateParticles(particles, 0.003f, fields);
+			for (size_t i = 0; i < count; ++i)
+			{
+				frame[2 * i] = particles[i].position.x;
+				frame[2 * i + 1] = particles[i].position.y;
+				frame[2 * count + 2 * i] = particles[i].velocity.x;
+				frame[2 * count + 2 * i + 1] = particles[i].velocity.y;
+				frame[4 * count + i] = particles[i].density;
+			}
+			payload.clear();
+			encoder.encode(frame.data(), count, payload);
+			rawBytes += frame.size() * sizeof(float);
+			codedBytes += payload.size();
+		}
+		return double(rawBytes) / codedBytes;
+	}
+}
+
+// Round trips stay within the error bound across keyframes, including the finest accepted bound;
+// bounds the quantizer cannot represent are rejected up front instead of failing on the I/O thread
+int main()
+{
+	bool ok = true;
+
+	for (float errorBound : {1e-3f, 1e-4f, TrajectoryCodecSettings::minimumErrorBound})
+	{
+		const float worst = roundTrip(uniformBound(errorBound), 400, 70);
+		const bool passed = worst <= 1.0f;
+		std::printf("error bound %.0e: worst error %.3f of the bound %s\n", errorBound, worst, passed ? "ok" : "FAILED");
+		ok &= passed;
+	}
+	{
+		const float worst = roundTrip(TrajectoryCodecSettings(), 40, 70);
+		const bool passed = worst <= 1.0f;
+		std::printf("default bounds: worst error %.3f of the bound %s\n", worst, passed ? "ok" : "FAILED");
+		ok &= passed;
+	}
+
+	for (float errorBound : {1e-12f, 1e-7f, 0.0f, -1e-4f, 0.75f, std::numeric_limits<float>::quiet_NaN()})
+	{
+		TrajectoryCodecSettings velocity, density;
+		velocity.velocityErrorBound = errorBound;
+		density.densityErrorBound = errorBound;
+		const bool passed = rejected(uniformBound(errorBound)) && rejected(velocity) && rejected(density);
+		std::printf("error bound %g: %s\n", errorBound, passed ? "rejected" : "ACCEPTED");
+		ok &= passed;
+	}
+
+	// the README promises 5-10x for the recorded fields at the default bounds
+	{
+		const double ratio = simulatedRatio(TrajectoryCodecSettings(), 60);
+		const bool passed = ratio >= 5.0;
+		std::printf("simulated frames: %.2fx %s\n", ratio, passed ? "ok" : "FAILED");
+		ok &= passed;
+	}
+
+	// extreme and non-finite values must encode without overflowing the quantizer
+	{
+		TrajectoryEncoder encoder(allFields, TrajectoryCodecSettings());
+		TrajectoryDecoder decoder(allFields);
+		std::vector<float> frame = makeFrame(64, 0);
+		frame[0] = FLT_MAX;
+		frame[1] = -FLT_MAX;
+		frame[2] = std::numeric_limits<float>::infinity();
+		frame[3] = std::numeric_limits<float>::quiet_NaN();
+		std::vector<uint8_t> payload;
+		std::vector<float> decoded;
+		bool passed = true;
+		for (int repeat = 0; repeat < 3 && passed; ++repeat)
+		{
+			payload.clear();
+			encoder.encode(frame.data(), 64, payload);
+			decoder.decode(payload.data(), payload.size(), decoded);
+			passed = decoded.size() == frame.size();
+		}
+		std::printf("extreme values: %s\n", passed ? "ok" : "FAILED");
+		ok &= passed;
+	}
+	return ok ? 0 : 1;
+}